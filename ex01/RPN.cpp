@@ -1,13 +1,83 @@
 #include "RPN.hpp"
 
+#include <algorithm>
 #include <climits>
+#include <cstring>
+#include <limits>
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_add_overflow) && \
+    __has_builtin(__builtin_sub_overflow) && \
+    __has_builtin(__builtin_mul_overflow)
+#define RPN_HAS_CHECKED_ARITHMETIC 1
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 5
+#define RPN_HAS_CHECKED_ARITHMETIC 1
+#endif
+#ifndef RPN_HAS_CHECKED_ARITHMETIC
+#define RPN_HAS_CHECKED_ARITHMETIC 0
+#endif
+
+const size_t RPN::BLOCK_SIZE;
 
 // ----------------------------------------------------------------
 // Public static members
 
 int RPN::evaluate(const std::string &expression) {
-    while (!_stack.empty())
-        _stack.pop();
+    int result = 0;
+    size_t offset;
+
+    _throwStatus(tryEvaluate(expression, result, offset));
+    return result;
+}
+
+int64_t RPN::evaluateWide(const std::string &expression) {
+    int64_t result = 0;
+    size_t offset;
+
+    _throwStatus(tryEvaluateWide(expression, result, offset));
+    return result;
+}
+
+RPN::Status RPN::tryEvaluate(
+    const std::string &expression, int &result, size_t &offset) {
+    return _evaluate(expression, _stack, false, result, offset);
+}
+
+RPN::Status RPN::tryEvaluateWide(
+    const std::string &expression, int64_t &result, size_t &offset) {
+    return _evaluate(expression, _wideStack, true, result, offset);
+}
+
+void RPN::evaluateColumns(const std::string &expression,
+    const std::map<char, std::vector<int> > &columns,
+    std::vector<int> &results, std::vector<unsigned char> &status) {
+    _evaluateColumns(expression, columns, results, status);
+}
+
+void RPN::evaluateColumns(const std::string &expression,
+    const std::map<char, std::vector<int64_t> > &columns,
+    std::vector<int64_t> &results, std::vector<unsigned char> &status) {
+    _evaluateColumns(expression, columns, results, status);
+}
+
+// ----------------------------------------------------------------
+// Static private members
+
+std::stack<int, std::list<int> > RPN::_stack =
+    std::stack<int, std::list<int> >();
+std::stack<int64_t, std::list<int64_t> > RPN::_wideStack =
+    std::stack<int64_t, std::list<int64_t> >();
+std::map<std::string, RPN::CachedProgram> RPN::_programCache =
+    std::map<std::string, RPN::CachedProgram>();
+std::list<std::string> RPN::_programCacheAge = std::list<std::string>();
+
+template <typename T>
+RPN::Status RPN::_evaluate(const std::string &expression,
+    std::stack<T, std::list<T> > &stack, bool multiDigit, T &result,
+    size_t &offset) {
+    while (!stack.empty())
+        stack.pop();
 
     for (size_t i = 0; i < expression.length(); ++i) {
         char c = expression[i];
@@ -15,65 +85,129 @@ int RPN::evaluate(const std::string &expression) {
         if (isspace(c))
             continue;
 
+        offset = i;
         if (isdigit(c)) {
-            _stack.push(c - '0');
+            T value = c - '0';
+            while (multiDigit && i + 1 < expression.length() &&
+                   isdigit(expression[i + 1])) {
+                T digit = expression[++i] - '0';
+                T ten = 10;
+                if (!_checkedOperation('*', value, ten, value) ||
+                    !_checkedOperation('+', value, digit, value))
+                    return STATUS_OVERFLOW;
+            }
+            stack.push(value);
         } else if (_isOperator(c)) {
-            if (_stack.size() < 2)
-                throw std::invalid_argument("invalid expression");
+            if (stack.size() < 2)
+                return STATUS_INVALID_EXPRESSION;
 
-            int b = _stack.top();
-            _stack.pop();
-            int a = _stack.top();
-            _stack.pop();
+            T b = stack.top();
+            stack.pop();
+            T a = stack.top();
+            stack.pop();
 
-            int result = _applyOperator(c, a, b);
-            _stack.push(result);
+            T value;
+            Status status = _applyOperator(c, a, b, value);
+            if (status != STATUS_OK)
+                return status;
+            stack.push(value);
         } else {
-            throw std::invalid_argument("");
+            return STATUS_INVALID_TOKEN;
         }
     }
 
-    if (_stack.size() != 1)
-        throw std::invalid_argument("invalid expression");
+    offset = expression.length();
+    if (stack.size() != 1)
+        return STATUS_INVALID_EXPRESSION;
 
-    return _stack.top();
+    result = stack.top();
+    return STATUS_OK;
 }
 
-// ----------------------------------------------------------------
-// Static private members
-
-std::stack<int, std::list<int> > RPN::_stack =
-    std::stack<int, std::list<int> >();
+void RPN::_throwStatus(Status status) {
+    switch (status) {
+        case STATUS_OK:
+            return;
+        case STATUS_INVALID_TOKEN:
+            throw std::invalid_argument("");
+        case STATUS_INVALID_EXPRESSION:
+            throw std::invalid_argument("invalid expression");
+        case STATUS_DIVISION_BY_ZERO:
+            throw std::invalid_argument("division by zero");
+        case STATUS_OVERFLOW:
+            throw std::overflow_error("overflow");
+    }
+}
 
 bool RPN::_isOperator(char c) {
     return c == '+' || c == '-' || c == '*' || c == '/';
 }
 
-int RPN::_applyOperator(char op, int a, int b) {
+bool RPN::_isVariable(char c) {
+    return c >= 'a' && c <= 'z';
+}
+
+template <typename T>
+RPN::Status RPN::_applyOperator(char op, T a, T b, T &result) {
+    if (!_isOperator(op))
+        return STATUS_INVALID_TOKEN;
+    if (op == '/' && b == 0)
+        return STATUS_DIVISION_BY_ZERO;
+    if (!_checkedOperation(op, a, b, result))
+        return STATUS_OVERFLOW;
+    return STATUS_OK;
+}
+
+// Compute `a op b` into result, returning false if it does not fit in T.
+// Uses the compiler's checked arithmetic when available, otherwise the
+// portable _willOverflow() tests. Division by zero is handled by callers.
+template <typename T>
+bool RPN::_checkedOperation(char op, T a, T b, T &result) {
+#if RPN_HAS_CHECKED_ARITHMETIC
     switch (op) {
         case '+':
-            if (_willOverflow(a, b, op))
-                throw std::overflow_error("overflow");
-            return a + b;
+            return !__builtin_add_overflow(a, b, &result);
         case '-':
-            if (_willOverflow(a, b, op))
-                throw std::overflow_error("overflow");
-            return a - b;
+            return !__builtin_sub_overflow(a, b, &result);
         case '*':
-            if (_willOverflow(a, b, op))
-                throw std::overflow_error("overflow");
-            return a * b;
+            return !__builtin_mul_overflow(a, b, &result);
         case '/':
-            if (b == 0)
-                throw std::invalid_argument("division by zero");
-            if (_willOverflow(a, b, op))
-                throw std::overflow_error("overflow");
-            return a / b;
+            if (a == std::numeric_limits<T>::min() && b == -1)
+                return false;
+            result = a / b;
+            return true;
         default:
-            throw std::invalid_argument("invalid operator");
+            return false;
+    }
+#else
+    if (_willOverflow(a, b, op))
+        return false;
+    switch (op) {
+        case '+':
+            result = a + b;
+            return true;
+        case '-':
+            result = a - b;
+            return true;
+        case '*':
+            result = a * b;
+            return true;
+        case '/':
+            result = a / b;
+            return true;
+        default:
+            return false;
     }
+#endif
 }
 
+// Shared with RPNStream
+template RPN::Status RPN::_applyOperator<int>(char, int, int, int &);
+template RPN::Status RPN::_applyOperator<int64_t>(
+    char, int64_t, int64_t, int64_t &);
+template bool RPN::_checkedOperation<int64_t>(
+    char, int64_t, int64_t, int64_t &);
+
 bool RPN::_willOverflow(int a, int b, char op) {
     switch (op) {
         case '+':
@@ -81,16 +215,368 @@ bool RPN::_willOverflow(int a, int b, char op) {
         case '-':
             return (b < 0 && a > INT_MAX + b) || (b > 0 && a < INT_MIN + b);
         case '*':
-            if (a == 0 || b == 0)
-                return false;
-            if (a == -1 && b == INT_MIN)
-                return true;
-            if (b == -1 && a == INT_MIN)
-                return true;
-            return a > INT_MAX / b || a < INT_MIN / b;
+            if (a > 0)
+                return b > 0 ? a > INT_MAX / b : b < INT_MIN / a;
+            if (b > 0)
+                return a < INT_MIN / b;
+            return a != 0 && b < INT_MAX / a;
         case '/':  // Division by zero is handled separately
             return (a == INT_MIN && b == -1);
         default:
             return false;
     }
 }
+
+bool RPN::_willOverflow(int64_t a, int64_t b, char op) {
+    const int64_t max = std::numeric_limits<int64_t>::max();
+    const int64_t min = std::numeric_limits<int64_t>::min();
+
+    switch (op) {
+        case '+':
+            return (b > 0 && a > max - b) || (b < 0 && a < min - b);
+        case '-':
+            return (b < 0 && a > max + b) || (b > 0 && a < min + b);
+        case '*':
+            if (a > 0)
+                return b > 0 ? a > max / b : b < min / a;
+            if (b > 0)
+                return a < min / b;
+            return a != 0 && b < max / a;
+        case '/':  // Division by zero is handled separately
+            return (a == min && b == -1);
+        default:
+            return false;
+    }
+}
+
+// ----------------------------------------------------------------
+// Column evaluation
+
+// Translate the expression into slot instructions. Slots follow the stack
+// depth, so the slot count is the maximum depth reached.
+void RPN::_compile(const std::string &expression, Program &program) {
+    size_t depth = 0;
+    size_t maxDepth = 0;
+
+    program.code.clear();
+    for (size_t i = 0; i < expression.length(); ++i) {
+        char c = expression[i];
+
+        if (isspace(c))
+            continue;
+
+        Instruction ins;
+        ins.op = LOAD_CONSTANT;
+        ins.variable = 0;
+        ins.constant = 0;
+        ins.dst = depth;
+        ins.lhs = depth;
+        ins.rhs = depth;
+        if (isdigit(c)) {
+            ins.constant = c - '0';
+            ++depth;
+        } else if (_isVariable(c)) {
+            ins.op = LOAD_COLUMN;
+            ins.variable = c;
+            ++depth;
+        } else if (_isOperator(c)) {
+            if (depth < 2)
+                throw std::invalid_argument("invalid expression");
+            ins.op = c;
+            ins.dst = depth - 2;
+            ins.lhs = depth - 2;
+            ins.rhs = depth - 1;
+            --depth;
+        } else {
+            throw std::invalid_argument("");
+        }
+        if (depth > maxDepth)
+            maxDepth = depth;
+        program.code.push_back(ins);
+    }
+
+    if (depth != 1)
+        throw std::invalid_argument("invalid expression");
+
+    program.slots = maxDepth;
+    program.result = 0;
+}
+
+// Rebuild the program as an expression DAG: constant subexpressions are
+// folded with the lane type's arithmetic, identical subexpressions are
+// computed once, and slots are reused as soon as a value is dead.
+// Operations that would fail are left in place, and nodes keep the order of
+// their first occurrence, so every row still reports its first error.
+template <typename T>
+void RPN::_optimize(Program &program) {
+    std::vector<Instruction> nodes;
+    std::vector<size_t> operands;
+    std::map<NodeKey, size_t> seen;
+
+    for (size_t i = 0; i < program.code.size(); ++i) {
+        Instruction node = program.code[i];
+        node.dst = node.lhs = node.rhs = 0;
+
+        if (_isOperator(node.op)) {
+            node.rhs = operands.back();
+            operands.pop_back();
+            node.lhs = operands.back();
+            operands.pop_back();
+
+            const Instruction &a = nodes[node.lhs];
+            const Instruction &b = nodes[node.rhs];
+            T folded;
+            if (a.op == LOAD_CONSTANT && b.op == LOAD_CONSTANT &&
+                !(node.op == '/' && b.constant == 0) &&
+                _checkedOperation(node.op, static_cast<T>(a.constant),
+                    static_cast<T>(b.constant), folded)) {
+                node.op = LOAD_CONSTANT;
+                node.constant = folded;
+                node.lhs = node.rhs = 0;
+            } else if ((node.op == '+' || node.op == '*') &&
+                       node.lhs > node.rhs) {
+                std::swap(node.lhs, node.rhs);
+            }
+        }
+
+        NodeKey key(std::make_pair(node.op, node.variable),
+            std::make_pair(node.constant, std::make_pair(node.lhs, node.rhs)));
+        std::map<NodeKey, size_t>::iterator it = seen.find(key);
+        if (it == seen.end()) {
+            it = seen.insert(std::make_pair(key, nodes.size())).first;
+            nodes.push_back(node);
+        }
+        operands.push_back(it->second);
+    }
+
+    // Keep the nodes the result depends on, and note where each dies
+    size_t root = operands.back();
+    std::vector<bool> live(nodes.size(), false);
+    std::vector<size_t> lastUse(nodes.size(), 0);
+    live[root] = true;
+    for (size_t i = root + 1; i-- > 0;) {
+        if (!live[i] || !_isOperator(nodes[i].op))
+            continue;
+        live[nodes[i].lhs] = live[nodes[i].rhs] = true;
+        lastUse[nodes[i].lhs] = std::max(lastUse[nodes[i].lhs], i);
+        lastUse[nodes[i].rhs] = std::max(lastUse[nodes[i].rhs], i);
+    }
+
+    std::vector<size_t> slotOf(nodes.size(), 0);
+    std::vector<size_t> freeSlots;
+    program.code.clear();
+    program.slots = 0;
+    for (size_t i = 0; i <= root; ++i) {
+        if (!live[i])
+            continue;
+
+        Instruction ins = nodes[i];
+        if (_isOperator(ins.op)) {
+            ins.lhs = slotOf[nodes[i].lhs];
+            ins.rhs = slotOf[nodes[i].rhs];
+            if (lastUse[nodes[i].lhs] == i)
+                freeSlots.push_back(ins.lhs);
+            if (lastUse[nodes[i].rhs] == i && nodes[i].rhs != nodes[i].lhs)
+                freeSlots.push_back(ins.rhs);
+        }
+        if (freeSlots.empty()) {
+            ins.dst = program.slots++;
+        } else {
+            ins.dst = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        slotOf[i] = ins.dst;
+        program.code.push_back(ins);
+    }
+    program.result = slotOf[root];
+}
+
+// Look up the optimized program for an expression, compiling it on a miss.
+// The least recently used program is dropped once the cache is full.
+template <typename T>
+const RPN::Program &RPN::_compiled(const std::string &expression) {
+    // Folding depends on the lane width, so programs are cached per type
+    std::string key(1, static_cast<char>('0' + sizeof(T)));
+    key += expression;
+
+    std::map<std::string, CachedProgram>::iterator it =
+        _programCache.find(key);
+    if (it != _programCache.end()) {
+        _programCacheAge.splice(
+            _programCacheAge.begin(), _programCacheAge, it->second.age);
+        return it->second.program;
+    }
+
+    Program program;
+    _compile(expression, program);
+    _optimize<T>(program);
+
+    if (_programCache.size() >= PROGRAM_CACHE_SIZE) {
+        _programCache.erase(_programCacheAge.back());
+        _programCacheAge.pop_back();
+    }
+    _programCacheAge.push_front(key);
+    CachedProgram &entry = _programCache[key];
+    entry.program = program;
+    entry.age = _programCacheAge.begin();
+    return entry.program;
+}
+
+template <typename T>
+void RPN::_evaluateColumns(const std::string &expression,
+    const std::map<char, std::vector<T> > &columns, std::vector<T> &results,
+    std::vector<unsigned char> &status) {
+    typedef typename std::map<char, std::vector<T> >::const_iterator ColumnIt;
+
+    const Program &compiled = _compiled<T>(expression);
+    const std::vector<Instruction> &program = compiled.code;
+
+    // Resolve column bindings up front so the inner loops only see pointers
+    size_t rows = columns.empty() ? 0 : columns.begin()->second.size();
+    for (ColumnIt it = columns.begin(); it != columns.end(); ++it) {
+        if (it->second.size() != rows)
+            throw std::invalid_argument("column size mismatch");
+    }
+    std::vector<const T *> bound(program.size(), static_cast<const T *>(0));
+    for (size_t i = 0; i < program.size(); ++i) {
+        if (program[i].op != LOAD_COLUMN)
+            continue;
+        ColumnIt it = columns.find(program[i].variable);
+        if (it == columns.end())
+            throw std::invalid_argument("unbound variable");
+        bound[i] = rows ? &it->second[0] : 0;
+    }
+
+    results.assign(rows, 0);
+    status.assign(rows, ROW_OK);
+    if (rows == 0)
+        return;
+
+    std::vector<T> stack(compiled.slots * BLOCK_SIZE);
+    const T *result = &stack[compiled.result * BLOCK_SIZE];
+    for (size_t begin = 0; begin < rows; begin += BLOCK_SIZE) {
+        size_t n = rows - begin < BLOCK_SIZE ? rows - begin : BLOCK_SIZE;
+        unsigned char *rowStatus = &status[begin];
+
+        for (size_t i = 0; i < program.size(); ++i) {
+            const Instruction &ins = program[i];
+            T *dst = &stack[ins.dst * BLOCK_SIZE];
+
+            if (ins.op == LOAD_CONSTANT) {
+                std::fill(dst, dst + n, static_cast<T>(ins.constant));
+            } else if (ins.op == LOAD_COLUMN) {
+                std::memcpy(dst, bound[i] + begin, n * sizeof(T));
+            } else {
+                _applyLanes(ins.op, dst, &stack[ins.lhs * BLOCK_SIZE],
+                    &stack[ins.rhs * BLOCK_SIZE], rowStatus, n);
+            }
+        }
+
+        for (size_t r = 0; r < n; ++r)
+            results[begin + r] = rowStatus[r] == ROW_OK ? result[r] : 0;
+    }
+}
+
+// The lane kernels keep the first error of each row, like evaluate() which
+// stops at the first failing operator. They are written without early exits
+// so the compiler can vectorize them.
+void RPN::_applyLanes(char op, int *dst, const int *lhs, const int *rhs,
+    unsigned char *status, size_t n) {
+    switch (op) {
+        case '+':
+            for (size_t i = 0; i < n; ++i) {
+                int64_t r = static_cast<int64_t>(lhs[i]) + rhs[i];
+                unsigned char s = (r < INT_MIN || r > INT_MAX) ? ROW_OVERFLOW
+                                                               : ROW_OK;
+                status[i] = status[i] ? status[i] : s;
+                dst[i] = static_cast<int>(r);
+            }
+            break;
+        case '-':
+            for (size_t i = 0; i < n; ++i) {
+                int64_t r = static_cast<int64_t>(lhs[i]) - rhs[i];
+                unsigned char s = (r < INT_MIN || r > INT_MAX) ? ROW_OVERFLOW
+                                                               : ROW_OK;
+                status[i] = status[i] ? status[i] : s;
+                dst[i] = static_cast<int>(r);
+            }
+            break;
+        case '*':
+            for (size_t i = 0; i < n; ++i) {
+                int64_t r = static_cast<int64_t>(lhs[i]) * rhs[i];
+                unsigned char s = (r < INT_MIN || r > INT_MAX) ? ROW_OVERFLOW
+                                                               : ROW_OK;
+                status[i] = status[i] ? status[i] : s;
+                dst[i] = static_cast<int>(r);
+            }
+            break;
+        case '/':
+            for (size_t i = 0; i < n; ++i) {
+                int b = rhs[i] == 0 ? 1 : rhs[i];
+                int64_t r = static_cast<int64_t>(lhs[i]) / b;
+                unsigned char s = rhs[i] == 0 ? ROW_DIVISION_BY_ZERO
+                                  : r > INT_MAX ? ROW_OVERFLOW
+                                                : ROW_OK;
+                status[i] = status[i] ? status[i] : s;
+                dst[i] = static_cast<int>(r);
+            }
+            break;
+        default:
+            throw std::invalid_argument("invalid operator");
+    }
+}
+
+void RPN::_applyLanes(char op, int64_t *dst, const int64_t *lhs,
+    const int64_t *rhs, unsigned char *status, size_t n) {
+    const int64_t min = std::numeric_limits<int64_t>::min();
+
+    switch (op) {
+        case '+':
+            // Wrap in unsigned arithmetic; the sign of the operands and of
+            // the result tells whether it overflowed.
+            for (size_t i = 0; i < n; ++i) {
+                int64_t r = static_cast<int64_t>(
+                    static_cast<uint64_t>(lhs[i]) + rhs[i]);
+                unsigned char s = ((lhs[i] ^ r) & (rhs[i] ^ r)) < 0
+                                      ? ROW_OVERFLOW
+                                      : ROW_OK;
+                status[i] = status[i] ? status[i] : s;
+                dst[i] = r;
+            }
+            break;
+        case '-':
+            for (size_t i = 0; i < n; ++i) {
+                int64_t r = static_cast<int64_t>(
+                    static_cast<uint64_t>(lhs[i]) - rhs[i]);
+                unsigned char s = ((lhs[i] ^ rhs[i]) & (lhs[i] ^ r)) < 0
+                                      ? ROW_OVERFLOW
+                                      : ROW_OK;
+                status[i] = status[i] ? status[i] : s;
+                dst[i] = r;
+            }
+            break;
+        case '*':
+            // No wider lane type to check against, use the scalar check
+            for (size_t i = 0; i < n; ++i) {
+                int64_t r = 0;
+                bool overflow = !_checkedOperation('*', lhs[i], rhs[i], r);
+                unsigned char s = overflow ? ROW_OVERFLOW : ROW_OK;
+                status[i] = status[i] ? status[i] : s;
+                dst[i] = r;
+            }
+            break;
+        case '/':
+            for (size_t i = 0; i < n; ++i) {
+                bool overflow = lhs[i] == min && rhs[i] == -1;
+                int64_t b = (rhs[i] == 0 || overflow) ? 1 : rhs[i];
+                unsigned char s = rhs[i] == 0 ? ROW_DIVISION_BY_ZERO
+                                  : overflow  ? ROW_OVERFLOW
+                                              : ROW_OK;
+                status[i] = status[i] ? status[i] : s;
+                dst[i] = lhs[i] / b;
+            }
+            break;
+        default:
+            throw std::invalid_argument("invalid operator");
+    }
+}
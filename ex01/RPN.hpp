@@ -1,22 +1,121 @@
 #ifndef RPN_HPP
 #define RPN_HPP
 
+#include <stdint.h>
+
 #include <exception>
 #include <list>
+#include <map>
 #include <stack>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 class RPN {
    public:
+    // Outcome of tryEvaluate(); each maps to one exception of evaluate()
+    enum Status {
+        STATUS_OK = 0,
+        STATUS_INVALID_TOKEN,       // invalid_argument("")
+        STATUS_INVALID_EXPRESSION,  // invalid_argument("invalid expression")
+        STATUS_DIVISION_BY_ZERO,    // invalid_argument("division by zero")
+        STATUS_OVERFLOW             // overflow_error("overflow")
+    };
+
+    // Per-row outcome written by evaluateColumns()
+    enum RowStatus { ROW_OK = 0, ROW_OVERFLOW, ROW_DIVISION_BY_ZERO };
+
     static int evaluate(const std::string &expression);
+    // Same grammar with multi-digit literals and 64-bit results
+    static int64_t evaluateWide(const std::string &expression);
+
+    // Non-throwing variants. On failure `offset` is the byte offset of the
+    // failing token, or the length of the expression when operands are left
+    // over at the end; `result` is only written on success.
+    static Status tryEvaluate(
+        const std::string &expression, int &result, size_t &offset);
+    static Status tryEvaluateWide(
+        const std::string &expression, int64_t &result, size_t &offset);
+
+    // Evaluate one expression over a table of rows. Lowercase letters are
+    // variables bound to the column of the same name; every column must have
+    // the same number of rows. Malformed expressions throw like evaluate(),
+    // arithmetic errors are reported per row in `status` (result is 0).
+    static void evaluateColumns(const std::string &expression,
+        const std::map<char, std::vector<int> > &columns,
+        std::vector<int> &results, std::vector<unsigned char> &status);
+    static void evaluateColumns(const std::string &expression,
+        const std::map<char, std::vector<int64_t> > &columns,
+        std::vector<int64_t> &results, std::vector<unsigned char> &status);
 
    private:
+    friend class RPNStream;
+
+    // One step of a compiled column program: slot[dst] = slot[lhs] op
+    // slot[rhs], or a load of a constant / a column into slot[dst].
+    struct Instruction {
+        char op;  // operator, or LOAD_CONSTANT / LOAD_COLUMN
+        char variable;
+        int64_t constant;
+        size_t dst;
+        size_t lhs;
+        size_t rhs;
+    };
+
+    struct Program {
+        std::vector<Instruction> code;
+        size_t slots;
+        size_t result;  // slot holding the value of the expression
+    };
+
+    struct CachedProgram {
+        Program program;
+        std::list<std::string>::iterator age;
+    };
+
+    // (op, variable) and (constant, (lhs, rhs)) of an expression node
+    typedef std::pair<std::pair<char, char>,
+        std::pair<int64_t, std::pair<size_t, size_t> > >
+        NodeKey;
+
+    static const char LOAD_CONSTANT = 'k';
+    static const char LOAD_COLUMN = 'v';
+    static const size_t BLOCK_SIZE = 256;  // rows evaluated per operator pass
+    static const size_t PROGRAM_CACHE_SIZE = 64;
+
     static std::stack<int, std::list<int> > _stack;
+    static std::stack<int64_t, std::list<int64_t> > _wideStack;
+    static std::map<std::string, CachedProgram> _programCache;
+    static std::list<std::string> _programCacheAge;  // most recent first
 
+    template <typename T>
+    static Status _evaluate(const std::string &expression,
+        std::stack<T, std::list<T> > &stack, bool multiDigit, T &result,
+        size_t &offset);
+    static void _throwStatus(Status status);
     static bool _isOperator(char c);
-    static int _applyOperator(char op, int a, int b);
+    static bool _isVariable(char c);
+    template <typename T>
+    static Status _applyOperator(char op, T a, T b, T &result);
+    template <typename T>
+    static bool _checkedOperation(char op, T a, T b, T &result);
     static bool _willOverflow(int a, int b, char op);
+    static bool _willOverflow(int64_t a, int64_t b, char op);
+
+    // Column evaluation
+    static void _compile(const std::string &expression, Program &program);
+    template <typename T>
+    static void _optimize(Program &program);
+    template <typename T>
+    static const Program &_compiled(const std::string &expression);
+    template <typename T>
+    static void _evaluateColumns(const std::string &expression,
+        const std::map<char, std::vector<T> > &columns,
+        std::vector<T> &results, std::vector<unsigned char> &status);
+    static void _applyLanes(char op, int *dst, const int *lhs, const int *rhs,
+        unsigned char *status, size_t n);
+    static void _applyLanes(char op, int64_t *dst, const int64_t *lhs,
+        const int64_t *rhs, unsigned char *status, size_t n);
 
     RPN();                             // = delete;
     ~RPN();                            // = delete;
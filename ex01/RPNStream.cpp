@@ -0,0 +1,168 @@
+#include "RPNStream.hpp"
+
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <stdexcept>
+
+RPNStream::RPNStream()
+    : _wide(false),
+      _status(RPN::STATUS_OK),
+      _offset(0),
+      _maxDepth(0),
+      _inLiteral(false),
+      _literalOffset(0),
+      _stack() {}
+
+RPNStream::RPNStream(bool wide)
+    : _wide(wide),
+      _status(RPN::STATUS_OK),
+      _offset(0),
+      _maxDepth(0),
+      _inLiteral(false),
+      _literalOffset(0),
+      _stack() {}
+
+RPNStream::~RPNStream() {}
+
+RPNStream::RPNStream(RPNStream const &other)
+    : _wide(other._wide),
+      _status(other._status),
+      _offset(other._offset),
+      _maxDepth(other._maxDepth),
+      _inLiteral(other._inLiteral),
+      _literalOffset(other._literalOffset),
+      _stack(other._stack) {}
+
+RPNStream &RPNStream::operator=(RPNStream const &other) {
+    if (this != &other) {
+        _wide = other._wide;
+        _status = other._status;
+        _offset = other._offset;
+        _maxDepth = other._maxDepth;
+        _inLiteral = other._inLiteral;
+        _literalOffset = other._literalOffset;
+        _stack = other._stack;
+    }
+    return *this;
+}
+
+// ----------------------------------------------------------------
+// public member functions
+
+RPN::Status RPNStream::feed(const char *data, size_t length) {
+    for (size_t i = 0; i < length && _status == RPN::STATUS_OK; ++i) {
+        char c = data[i];
+        size_t offset = _offset++;
+
+        if (isdigit(c)) {
+            int64_t digit = c - '0';
+            if (!_inLiteral) {
+                _push(digit);
+                _inLiteral = _wide;
+                _literalOffset = offset;
+            } else if (!RPN::_checkedOperation('*', _stack.back(),
+                           static_cast<int64_t>(10), _stack.back()) ||
+                       !RPN::_checkedOperation(
+                           '+', _stack.back(), digit, _stack.back())) {
+                _fail(RPN::STATUS_OVERFLOW, _literalOffset);
+            }
+            continue;
+        }
+
+        _inLiteral = false;
+        if (isspace(c))
+            continue;
+        if (RPN::_isOperator(c)) {
+            if (_stack.size() < 2)
+                _fail(RPN::STATUS_INVALID_EXPRESSION, offset);
+            else if (_apply(c) != RPN::STATUS_OK)
+                _offset = offset;
+        } else {
+            _fail(RPN::STATUS_INVALID_TOKEN, offset);
+        }
+    }
+    return _status;
+}
+
+RPN::Status RPNStream::feedFd(int fd) {
+    std::vector<char> buffer(READ_SIZE);
+
+    while (_status == RPN::STATUS_OK) {
+        ssize_t bytes = read(fd, &buffer[0], buffer.size());
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes < 0)
+            throw std::runtime_error("read failed");
+        if (bytes == 0)
+            break;
+        feed(&buffer[0], static_cast<size_t>(bytes));
+    }
+    return _status;
+}
+
+RPN::Status RPNStream::finish(int64_t &result) {
+    _inLiteral = false;
+    if (_status != RPN::STATUS_OK)
+        return _status;
+    if (_stack.size() != 1)
+        return _fail(RPN::STATUS_INVALID_EXPRESSION, _offset);
+    result = _stack.back();
+    return _status;
+}
+
+void RPNStream::reset() {
+    _status = RPN::STATUS_OK;
+    _offset = 0;
+    _maxDepth = 0;
+    _inLiteral = false;
+    _literalOffset = 0;
+    _stack.clear();
+}
+
+RPN::Status RPNStream::status() const {
+    return _status;
+}
+
+size_t RPNStream::offset() const {
+    return _offset;
+}
+
+size_t RPNStream::maxDepth() const {
+    return _maxDepth;
+}
+
+// ----------------------------------------------------------------
+// private member functions
+
+RPN::Status RPNStream::_fail(RPN::Status status, size_t offset) {
+    _status = status;
+    _offset = offset;
+    return _status;
+}
+
+RPN::Status RPNStream::_push(int64_t value) {
+    _stack.push_back(value);
+    if (_stack.size() > _maxDepth)
+        _maxDepth = _stack.size();
+    return _status;
+}
+
+// Operands are stored as int64_t; the narrow grammar applies int arithmetic
+// so that overflow is reported exactly as RPN::evaluate() does.
+RPN::Status RPNStream::_apply(char op) {
+    int64_t b = _stack.back();
+    _stack.pop_back();
+    int64_t a = _stack.back();
+
+    if (_wide) {
+        _status = RPN::_applyOperator(op, a, b, _stack.back());
+    } else {
+        int result = 0;
+        _status = RPN::_applyOperator(
+            op, static_cast<int>(a), static_cast<int>(b), result);
+        _stack.back() = result;
+    }
+    return _status;
+}
@@ -0,0 +1,52 @@
+#ifndef RPNSTREAM_HPP
+#define RPNSTREAM_HPP
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "RPN.hpp"
+
+// Incremental RPN evaluation for expressions too large to hold in memory.
+// Input is fed in chunks of any size (tokens may straddle chunks) and only
+// the operand stack is kept. The grammar is the one of RPN::evaluate(), or of
+// RPN::evaluateWide() when constructed with wide = true. Errors are sticky:
+// once a chunk fails, later calls return the same status.
+class RPNStream {
+   public:
+    RPNStream();
+    explicit RPNStream(bool wide);
+    ~RPNStream();
+    RPNStream(RPNStream const &other);
+    RPNStream &operator=(RPNStream const &other);
+
+    RPN::Status feed(const char *data, size_t length);
+    // Read and feed `fd` until end of file
+    RPN::Status feedFd(int fd);
+    // End of input: check the final stack and read the result
+    RPN::Status finish(int64_t &result);
+    void reset();
+
+    RPN::Status status() const;
+    // Failing byte offset, or bytes consumed so far
+    size_t offset() const;
+    size_t maxDepth() const;
+
+   private:
+    static const size_t READ_SIZE = 65536;
+
+    bool _wide;
+    RPN::Status _status;
+    size_t _offset;
+    size_t _maxDepth;
+    bool _inLiteral;  // wide mode: a literal may continue in the next chunk
+    size_t _literalOffset;
+    std::vector<int64_t> _stack;
+
+    RPN::Status _fail(RPN::Status status, size_t offset);
+    RPN::Status _push(int64_t value);
+    RPN::Status _apply(char op);
+};
+
+#endif /* RPNSTREAM_HPP */
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "RPN.hpp"
+#include "RPNStream.hpp"
+
+// Micro-benchmark for the RPN evaluators.
+// Usage: ./RPN_bench [tokens=N] [count=N] [depth=N] [ops=+-*/]
+//                    [invalid=PERCENT] [rows=N] [seed=N]
+// Numbers are whole decimals within the limits below; counts, rows and
+// tokens must be positive, and a workload holds at most
+// MAX_WORKLOAD_TOKENS operands.
+
+// ----------------------------------------------------------------
+// Allocation counting
+
+static size_t g_allocations = 0;
+
+void *operator new(std::size_t size) throw(std::bad_alloc) {
+    ++g_allocations;
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw() {
+    std::free(p);
+}
+
+// ----------------------------------------------------------------
+// Workload generation
+
+struct Options {
+    size_t tokens;   // operands per expression
+    size_t count;    // expressions per run
+    size_t depth;    // maximum stack depth
+    std::string ops;
+    int invalid;     // percentage of corrupted expressions
+    size_t rows;     // rows for the column engine
+    unsigned seed;
+};
+
+struct Workload {
+    std::vector<std::string> expressions;
+    size_t tokens;
+    size_t invalid;
+};
+
+// Build a well-formed expression with `operands` literals (or variables)
+// whose stack never grows beyond `depth`.
+std::string generateExpression(const Options &opt, const std::string &leaves) {
+    std::string expression;
+    size_t pushed = 0;
+    size_t depth = 0;
+
+    while (pushed < opt.tokens || depth > 1) {
+        bool canPush = pushed < opt.tokens && depth < opt.depth;
+        bool canReduce = depth >= 2;
+        if (canPush && (!canReduce || std::rand() % 2 == 0)) {
+            expression += leaves[std::rand() % leaves.size()];
+            ++pushed;
+            ++depth;
+        } else {
+            expression += opt.ops[std::rand() % opt.ops.size()];
+            --depth;
+        }
+        expression += ' ';
+    }
+    return expression;
+}
+
+// Break an expression: a bad token, a missing operator or an extra operand
+void corruptExpression(std::string &expression) {
+    size_t at = (std::rand() % (expression.length() / 2 + 1)) * 2;
+    switch (std::rand() % 3) {
+        case 0:
+            expression.insert(at, "& ");
+            break;
+        case 1:
+            expression.erase(expression.length() - 2);
+            break;
+        default:
+            expression += "1 ";
+            break;
+    }
+}
+
+// A well-formed expression can still fail (a division by zero, an
+// overflow): draw until one evaluates, so that the only failures measured
+// are the corrupted expressions, or keep the last one drawn.
+std::string generateValidExpression(const Options &opt) {
+    std::string expression;
+    int result;
+    size_t offset;
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        expression = generateExpression(opt, "123456789");
+        if (RPN::tryEvaluate(expression, result, offset) == RPN::STATUS_OK)
+            break;
+    }
+    return expression;
+}
+
+Workload generateWorkload(const Options &opt) {
+    Workload workload;
+    workload.tokens = 0;
+    workload.invalid = 0;
+    for (size_t i = 0; i < opt.count; ++i) {
+        std::string expression = generateValidExpression(opt);
+        if (std::rand() % 100 < opt.invalid) {
+            corruptExpression(expression);
+            ++workload.invalid;
+        }
+        workload.tokens += expression.length() / 2;
+        workload.expressions.push_back(expression);
+    }
+    return workload;
+}
+
+// ----------------------------------------------------------------
+// Measurement
+
+struct Measure {
+    std::clock_t start;
+    size_t allocations;
+
+    Measure() : start(std::clock()), allocations(g_allocations) {}
+};
+
+void report(const std::string &name, const Measure &m, size_t evaluations,
+    size_t tokens, size_t failures) {
+    double secs = static_cast<double>(std::clock() - m.start) / CLOCKS_PER_SEC;
+    size_t allocations = g_allocations - m.allocations;
+
+    std::cout << std::left << std::setw(22) << name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(10)
+              << secs * 1e9 / (tokens ? tokens : 1) << " ns/token"
+              << std::setw(14) << std::setprecision(0)
+              << evaluations / (secs > 0 ? secs : 1e-9) << " expr/s"
+              << std::setw(10) << std::setprecision(2)
+              << static_cast<double>(allocations) /
+                     (evaluations ? evaluations : 1)
+              << " alloc/expr" << std::setw(8) << failures << " errors"
+              << std::endl;
+}
+
+void benchThrowing(const Workload &w) {
+    Measure m;
+    size_t failures = 0;
+    for (size_t i = 0; i < w.expressions.size(); ++i) {
+        try {
+            RPN::evaluate(w.expressions[i]);
+        } catch (const std::exception &) {
+            ++failures;
+        }
+    }
+    report("evaluate", m, w.expressions.size(), w.tokens, failures);
+}
+
+void benchStatus(const Workload &w) {
+    Measure m;
+    size_t failures = 0;
+    int result;
+    size_t offset;
+    for (size_t i = 0; i < w.expressions.size(); ++i) {
+        if (RPN::tryEvaluate(w.expressions[i], result, offset) !=
+            RPN::STATUS_OK)
+            ++failures;
+    }
+    report("tryEvaluate", m, w.expressions.size(), w.tokens, failures);
+}
+
+void benchWide(const Workload &w) {
+    Measure m;
+    size_t failures = 0;
+    int64_t result;
+    size_t offset;
+    for (size_t i = 0; i < w.expressions.size(); ++i) {
+        if (RPN::tryEvaluateWide(w.expressions[i], result, offset) !=
+            RPN::STATUS_OK)
+            ++failures;
+    }
+    report("tryEvaluateWide", m, w.expressions.size(), w.tokens, failures);
+}
+
+void benchStream(const Workload &w) {
+    Measure m;
+    size_t failures = 0;
+    int64_t result;
+    RPNStream stream;
+    for (size_t i = 0; i < w.expressions.size(); ++i) {
+        stream.reset();
+        stream.feed(w.expressions[i].c_str(), w.expressions[i].length());
+        if (stream.finish(result) != RPN::STATUS_OK)
+            ++failures;
+    }
+    report("RPNStream", m, w.expressions.size(), w.tokens, failures);
+}
+
+// Cost of a failure on each path: evaluate the same invalid expression
+// repeatedly, throwing and non-throwing.
+void benchErrorPath(const Options &opt) {
+    const std::string bad = "1 2 3 +";
+    const size_t repeat = opt.count;
+    int result;
+    size_t offset;
+
+    Measure m;
+    for (size_t i = 0; i < repeat; ++i) {
+        try {
+            RPN::evaluate(bad);
+        } catch (const std::exception &) {
+        }
+    }
+    double thrown =
+        static_cast<double>(std::clock() - m.start) / CLOCKS_PER_SEC;
+    Measure s;
+    for (size_t i = 0; i < repeat; ++i)
+        RPN::tryEvaluate(bad, result, offset);
+    double returned =
+        static_cast<double>(std::clock() - s.start) / CLOCKS_PER_SEC;
+
+    std::cout << std::left << std::setw(22) << "error path" << std::right
+              << std::fixed << std::setprecision(1) << std::setw(10)
+              << thrown * 1e9 / repeat << " ns thrown" << std::setw(10)
+              << returned * 1e9 / repeat << " ns returned" << std::endl;
+}
+
+typedef std::map<char, std::vector<int64_t> > Columns;
+
+size_t failedRows(const std::vector<unsigned char> &status) {
+    size_t failures = 0;
+    for (size_t r = 0; r < status.size(); ++r)
+        failures += status[r] != RPN::ROW_OK;
+    return failures;
+}
+
+// A random expression can fail on nearly every row (a constant divisor of
+// 0, a quotient that truncates to 0): draw until one fails on at most a
+// tenth of the first rows, so that the column timing is not that of the
+// error path, or keep the last one drawn.
+std::string generateColumnExpression(const Options &opt,
+    const Columns &columns) {
+    size_t sample = std::min(opt.rows, static_cast<size_t>(1000));
+    Columns head;
+    for (Columns::const_iterator c = columns.begin(); c != columns.end(); ++c)
+        head[c->first].assign(c->second.begin(), c->second.begin() + sample);
+    std::string expression;
+    std::vector<int64_t> results;
+    std::vector<unsigned char> status;
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        expression = generateExpression(opt, "xy123456789");
+        RPN::evaluateColumns(expression, head, results, status);
+        if (failedRows(status) * 10 <= sample)
+            break;
+    }
+    return expression;
+}
+
+void benchColumns(const Options &opt) {
+    Columns columns;
+    for (size_t r = 0; r < opt.rows; ++r) {
+        columns['x'].push_back(std::rand() % 100);
+        columns['y'].push_back(std::rand() % 100);
+    }
+    std::vector<int64_t> results;
+    std::vector<unsigned char> status;
+    try {
+        std::string expression = generateColumnExpression(opt, columns);
+        size_t tokens = expression.length() / 2;
+
+        Measure m;
+        RPN::evaluateColumns(expression, columns, results, status);
+        report("evaluateColumns", m, opt.rows, tokens * opt.rows,
+            failedRows(status));
+    } catch (const std::exception &e) {
+        std::cout << std::left << std::setw(22) << "evaluateColumns"
+                  << "failed: " << e.what() << std::endl;
+    }
+}
+
+// ----------------------------------------------------------------
+// Options
+
+// Limits of the numeric options, which keep a run within memory
+const long MAX_TOKENS = 10000;
+const long MAX_COUNT = 1000000;
+const long MAX_DEPTH = 10000;
+const long MAX_ROWS = 10000000;
+const long MAX_SEED = INT_MAX;
+const size_t MAX_WORKLOAD_TOKENS = 20000000;
+
+// Parse all of `text` as a decimal in [min, max]. Read as a signed long,
+// so that "-1" is rejected instead of wrapping around in an unsigned type.
+template <typename T>
+bool parseNumber(const std::string &text, long min, long max, T &out) {
+    std::istringstream value(text);
+    long number;
+    if (!(value >> number) || !value.eof() || number < min || number > max)
+        return false;
+    out = static_cast<T>(number);
+    return true;
+}
+
+bool parseOption(const std::string &arg, Options &opt) {
+    size_t eq = arg.find('=');
+    if (eq == std::string::npos)
+        return false;
+    std::string key = arg.substr(0, eq);
+    std::string value = arg.substr(eq + 1);
+
+    if (key == "ops") {
+        opt.ops = value;
+        return !value.empty() &&
+               value.find_first_not_of("+-*/") == std::string::npos;
+    }
+    if (key == "tokens")
+        return parseNumber(value, 1, MAX_TOKENS, opt.tokens);
+    if (key == "count")
+        return parseNumber(value, 1, MAX_COUNT, opt.count);
+    if (key == "depth")
+        return parseNumber(value, 2, MAX_DEPTH, opt.depth);
+    if (key == "invalid")
+        return parseNumber(value, 0, 100, opt.invalid);
+    if (key == "rows")
+        return parseNumber(value, 1, MAX_ROWS, opt.rows);
+    if (key == "seed")
+        return parseNumber(value, 0, MAX_SEED, opt.seed);
+    return false;
+}
+
+int main(int argc, char **argv) {
+    Options opt;
+    opt.tokens = 16;
+    opt.count = 100000;
+    opt.depth = 8;
+    opt.ops = "+-*/";
+    opt.invalid = 10;
+    opt.rows = 1000000;
+    opt.seed = 42;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!parseOption(argv[i], opt)) {
+            std::cerr << "Usage: " << argv[0]
+                      << " [tokens=N] [count=N] [depth=N] [ops=+-*/]"
+                         " [invalid=PERCENT] [rows=N] [seed=N]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    if (opt.tokens * opt.count > MAX_WORKLOAD_TOKENS) {
+        std::cerr << "Error: tokens * count exceeds " << MAX_WORKLOAD_TOKENS
+                  << std::endl;
+        return 1;
+    }
+    std::srand(opt.seed);
+
+    Workload w = generateWorkload(opt);
+    std::cout << w.expressions.size() << " expressions, " << w.tokens
+              << " tokens, " << w.invalid << " corrupted" << std::endl;
+    benchThrowing(w);
+    benchStatus(w);
+    benchWide(w);
+    benchStream(w);
+    benchErrorPath(opt);
+    benchColumns(opt);
+    return 0;
+}
@@ -1,7 +1,12 @@
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <iostream>
 
+#include <unistd.h>
+
 #include "RPN.hpp"
+#include "RPNStream.hpp"
 
 void testRPN() {
     assert(RPN::evaluate("3 4 +") == 7);
@@ -24,6 +29,8 @@ void testRPN() {
            -2147483648);
 
     assert(RPN::evaluate("2 3 + 5 * 6 -") == 19);  // (2 + 3) * 5 - 6
+    assert(RPN::evaluate("5 0 1 - *") == -5);
+    assert(RPN::evaluate("0 5 - 0 1 - *") == 5);
 
     // Test invalid expressions
     try {
@@ -99,10 +106,246 @@ void testRPN() {
     }
 }
 
+void testRPNWide() {
+    assert(RPN::evaluateWide("13 2 +") == 15);
+    assert(RPN::evaluateWide("3 4 +") == 7);
+    assert(RPN::evaluateWide("100 7 /") == 14);
+    assert(RPN::evaluateWide("0 2 - 8 8 8 8 8 8 8 8 8 8 * * * * * * * * * * "
+                             "0 1 - /") == INT64_C(2147483648));
+    assert(RPN::evaluateWide("9223372036854775807") == INT64_MAX);
+    assert(RPN::evaluateWide("0 9223372036854775807 - 1 -") == INT64_MIN);
+    assert(RPN::evaluateWide("4294967296 2147483647 *") ==
+           INT64_C(9223372032559808512));
+
+    try {
+        RPN::evaluateWide("9223372036854775808");
+        assert(false);  // Should not reach here
+    } catch (std::overflow_error &e) {
+        assert(std::string(e.what()) == "overflow");
+    }
+    try {
+        RPN::evaluateWide("4294967296 4294967296 *");
+        assert(false);  // Should not reach here
+    } catch (std::overflow_error &e) {
+        assert(std::string(e.what()) == "overflow");
+    }
+    try {
+        RPN::evaluateWide("0 9223372036854775807 - 1 - 0 1 - /");
+        assert(false);  // Should not reach here
+    } catch (std::overflow_error &e) {
+        assert(std::string(e.what()) == "overflow");
+    }
+    try {
+        RPN::evaluateWide("42 0 /");
+        assert(false);  // Should not reach here
+    } catch (std::invalid_argument &e) {
+        assert(std::string(e.what()) == "division by zero");
+    }
+    try {
+        RPN::evaluateWide("12 +");
+        assert(false);  // Should not reach here
+    } catch (std::invalid_argument &e) {
+        assert(std::string(e.what()) == "invalid expression");
+    }
+    try {
+        RPN::evaluateWide("12 3.5 +");
+        assert(false);  // Should not reach here
+    } catch (std::invalid_argument &e) {
+        assert(std::string(e.what()) == "");
+    }
+}
+
+void testRPNStatus() {
+    int result = 0;
+    int64_t wideResult = 0;
+    size_t offset = 0;
+
+    assert(RPN::tryEvaluate("3 4 +", result, offset) == RPN::STATUS_OK);
+    assert(result == 7 && offset == 5);
+    assert(RPN::tryEvaluate("2 3 &", result, offset) ==
+           RPN::STATUS_INVALID_TOKEN);
+    assert(offset == 4 && result == 7);
+    assert(RPN::tryEvaluate("1 2 + +", result, offset) ==
+           RPN::STATUS_INVALID_EXPRESSION);
+    assert(offset == 6);
+    assert(RPN::tryEvaluate("1 2 3 +", result, offset) ==
+           RPN::STATUS_INVALID_EXPRESSION);
+    assert(offset == 7);
+    assert(RPN::tryEvaluate("1 4 0 / +", result, offset) ==
+           RPN::STATUS_DIVISION_BY_ZERO);
+    assert(offset == 6);
+    assert(RPN::tryEvaluate("0 2 - 8 8 8 8 8 8 8 8 8 8 * * * * * * * * * * 1 -",
+               result, offset) == RPN::STATUS_OVERFLOW);
+    assert(offset == 48);
+    assert(RPN::tryEvaluateWide("1 99999999999999999999 +", wideResult,
+               offset) == RPN::STATUS_OVERFLOW);
+    assert(offset == 2);
+    assert(RPN::tryEvaluateWide("12 34 *", wideResult, offset) ==
+           RPN::STATUS_OK);
+    assert(wideResult == 408);
+}
+
+void testRPNStream() {
+    int64_t result = 0;
+
+    // Byte-sized chunks give the same answers as evaluate()
+    const char *expressions[] = {"8 9 * 9 - 9 - 9 - 4 - 1 +",
+        "5 6 - 1 3 * 2 + 5 2 - * - 4 5 * * 8 /", "13 2 +", "4 0 /", "2 3 &",
+        "0 2 - 8 8 8 8 8 8 8 8 8 8 * * * * * * * * * * 1 -"};
+    for (size_t i = 0; i < sizeof(expressions) / sizeof(*expressions); ++i) {
+        std::string expression = expressions[i];
+        int expected = 0;
+        size_t expectedOffset = 0;
+        RPN::Status expectedStatus =
+            RPN::tryEvaluate(expression, expected, expectedOffset);
+
+        RPNStream stream;
+        for (size_t j = 0; j < expression.length(); ++j)
+            stream.feed(&expression[j], 1);
+        assert(stream.finish(result) == expectedStatus);
+        assert(stream.offset() == expectedOffset);
+        if (expectedStatus == RPN::STATUS_OK)
+            assert(result == expected);
+    }
+
+    // Wide literals may straddle chunks
+    RPNStream wide(true);
+    wide.feed("12", 2);
+    wide.feed("3 4", 3);
+    wide.feed("5 +", 3);
+    assert(wide.finish(result) == RPN::STATUS_OK && result == 168);
+    wide.reset();
+    wide.feed("1 9223372036854775807", 21);
+    wide.feed("0 +", 3);
+    assert(wide.finish(result) == RPN::STATUS_OVERFLOW && wide.offset() == 2);
+
+    // Deep expression fed in odd-sized chunks reports its depth
+    std::string deep;
+    for (int i = 0; i < 10000; ++i)
+        deep += "1 ";
+    for (int i = 1; i < 10000; ++i)
+        deep += "+ ";
+    RPNStream stream;
+    for (size_t i = 0; i < deep.length(); i += 7)
+        stream.feed(&deep[i], std::min<size_t>(7, deep.length() - i));
+    assert(stream.finish(result) == RPN::STATUS_OK && result == 10000);
+    assert(stream.maxDepth() == 10000);
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    std::string piped = "9 8 * 7 -\n";
+    assert(write(fds[1], piped.c_str(), piped.length()) ==
+           static_cast<ssize_t>(piped.length()));
+    close(fds[1]);
+    stream.reset();
+    assert(stream.feedFd(fds[0]) == RPN::STATUS_OK);
+    close(fds[0]);
+    assert(stream.finish(result) == RPN::STATUS_OK && result == 65);
+    assert(stream.maxDepth() == 2);
+}
+
+void testRPNColumns() {
+    std::map<char, std::vector<int> > columns;
+    int x[] = {1, 2, INT_MAX, 5, INT_MIN, 7};
+    int y[] = {3, 0, 1, -1, -1, 2};
+    columns['x'] = std::vector<int>(x, x + 6);
+    columns['y'] = std::vector<int>(y, y + 6);
+    std::vector<int> results;
+    std::vector<unsigned char> status;
+
+    RPN::evaluateColumns("x y +", columns, results, status);
+    assert(results.size() == 6 && status.size() == 6);
+    assert(results[0] == 4 && status[0] == RPN::ROW_OK);
+    assert(results[1] == 2 && status[1] == RPN::ROW_OK);
+    assert(results[2] == 0 && status[2] == RPN::ROW_OVERFLOW);
+    assert(results[4] == 0 && status[4] == RPN::ROW_OVERFLOW);
+
+    RPN::evaluateColumns("x y /", columns, results, status);
+    assert(results[0] == 0 && status[0] == RPN::ROW_OK);
+    assert(status[1] == RPN::ROW_DIVISION_BY_ZERO);
+    assert(results[3] == -5 && status[3] == RPN::ROW_OK);
+    assert(status[4] == RPN::ROW_OVERFLOW);  // INT_MIN / -1
+
+    // The first failing operator decides the status of a row
+    RPN::evaluateColumns("x y / x 2 * +", columns, results, status);
+    assert(status[1] == RPN::ROW_DIVISION_BY_ZERO);
+    assert(status[2] == RPN::ROW_OVERFLOW);
+    assert(results[5] == 17 && status[5] == RPN::ROW_OK);
+
+    // Rows agree with the scalar evaluator
+    RPN::evaluateColumns("8 x * y - 9 +", columns, results, status);
+    assert(results[0] == RPN::evaluate("8 1 * 3 - 9 +"));
+    assert(results[5] == RPN::evaluate("8 7 * 2 - 9 +"));
+
+    // Constant folding and shared subexpressions keep the results
+    RPN::evaluateColumns("x 8 8 * 8 * +", columns, results, status);
+    assert(results[0] == 513 && status[0] == RPN::ROW_OK);
+    RPN::evaluateColumns("x y + x y + * x y + -", columns, results, status);
+    assert(results[0] == 12 && status[0] == RPN::ROW_OK);
+    assert(results[3] == 12 && status[3] == RPN::ROW_OK);
+    assert(status[2] == RPN::ROW_OVERFLOW);
+    RPN::evaluateColumns("x 1 0 / +", columns, results, status);
+    for (size_t i = 0; i < status.size(); ++i)
+        assert(status[i] == RPN::ROW_DIVISION_BY_ZERO);
+    // 9^11 does not fit in int, but "x y /" fails first on row 1
+    RPN::evaluateColumns(
+        "x y / 9 9 * 9 * 9 * 9 * 9 * 9 * 9 * 9 * 9 * 9 * +", columns, results,
+        status);
+    assert(status[0] == RPN::ROW_OVERFLOW);
+    assert(status[1] == RPN::ROW_DIVISION_BY_ZERO);
+    RPN::evaluateColumns("4 2 /", columns, results, status);
+    assert(results[5] == 2 && status[5] == RPN::ROW_OK);
+
+    // Many rows, spanning several blocks
+    std::map<char, std::vector<int64_t> > wide;
+    for (int64_t i = 0; i < 1000; ++i) {
+        wide['a'].push_back(i);
+        wide['b'].push_back(i % 7);
+    }
+    wide['a'][999] = INT64_MAX;
+    std::vector<int64_t> wideResults;
+    RPN::evaluateColumns("a a * b /", wide, wideResults, status);
+    for (int64_t i = 0; i < 999; ++i) {
+        if (i % 7 == 0)
+            assert(status[i] == RPN::ROW_DIVISION_BY_ZERO);
+        else
+            assert(status[i] == RPN::ROW_OK && wideResults[i] == i * i / (i % 7));
+    }
+    assert(status[999] == RPN::ROW_OVERFLOW);
+    RPN::evaluateColumns(
+        "a 9 9 * 9 * 9 * 9 * 9 * 9 * 9 * 9 * 9 * 9 * +", wide, wideResults,
+        status);
+    assert(wideResults[1] == INT64_C(31381059610) && status[1] == RPN::ROW_OK);
+
+    try {
+        RPN::evaluateColumns("x z +", columns, results, status);
+        assert(false);  // Should not reach here
+    } catch (std::invalid_argument &e) {
+        assert(std::string(e.what()) == "unbound variable");
+    }
+    try {
+        RPN::evaluateColumns("x y", columns, results, status);
+        assert(false);  // Should not reach here
+    } catch (std::invalid_argument &e) {
+        assert(std::string(e.what()) == "invalid expression");
+    }
+    columns['z'] = std::vector<int>(2, 1);
+    try {
+        RPN::evaluateColumns("x y +", columns, results, status);
+        assert(false);  // Should not reach here
+    } catch (std::invalid_argument &e) {
+        assert(std::string(e.what()) == "column size mismatch");
+    }
+}
+
 int main(int argc, char **argv) {
 #if defined(DEBUG)
     std::cout << "Debug mode enabled" << std::endl;
     testRPN();
+    testRPNWide();
+    testRPNStatus();
+    testRPNStream();
+    testRPNColumns();
     std::cout << "All tests passed!" << std::endl;
     std::cout << "----------------------------" << std::endl;
 #endif
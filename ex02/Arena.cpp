@@ -0,0 +1,88 @@
+#include "Arena.hpp"
+
+#include <cstdlib>
+
+const size_t Arena::ALIGNMENT;
+const size_t Arena::MIN_CHUNK_SIZE;
+
+Arena::Arena()
+    : _chunks(), _cursor(NULL), _end(NULL), _nextChunkSize(MIN_CHUNK_SIZE),
+      _used(0), _peak(0) {}
+
+Arena::Arena(size_t capacity)
+    : _chunks(), _cursor(NULL), _end(NULL), _nextChunkSize(MIN_CHUNK_SIZE),
+      _used(0), _peak(0) {
+    if (capacity > 0)
+        _grow(capacity);
+}
+
+Arena::~Arena() {
+    release();
+}
+
+// ----------------------------------------------------------------
+// public member functions
+
+void *Arena::allocate(size_t bytes) {
+    bytes = _aligned(bytes);
+    if (static_cast<size_t>(_end - _cursor) < bytes)
+        _grow(bytes);
+    void *p = _cursor;
+    _cursor += bytes;
+    _used += bytes;
+    if (_used > _peak)
+        _peak = _used;
+    return p;
+}
+
+void Arena::deallocate(void *p, size_t bytes) {
+    bytes = _aligned(bytes);
+    if (static_cast<char *>(p) + bytes == _cursor) {
+        _cursor -= bytes;
+        _used -= bytes;
+    }
+}
+
+void Arena::release() {
+    for (size_t i = 0; i < _chunks.size(); ++i)
+        std::free(_chunks[i]);
+    _chunks.clear();
+    _cursor = NULL;
+    _end = NULL;
+    _nextChunkSize = MIN_CHUNK_SIZE;
+    _used = 0;
+    _peak = 0;
+}
+
+size_t Arena::used() const {
+    return _used;
+}
+
+size_t Arena::peak() const {
+    return _peak;
+}
+
+size_t Arena::chunks() const {
+    return _chunks.size();
+}
+
+// ----------------------------------------------------------------
+// private member functions
+
+size_t Arena::_aligned(size_t bytes) {
+    return (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+// Start a new chunk of at least `bytes`. Chunk sizes double so that an
+// undersized arena still needs only O(log n) chunks.
+void Arena::_grow(size_t bytes) {
+    size_t size = bytes > _nextChunkSize ? bytes : _nextChunkSize;
+    // malloc() memory is aligned for any scalar type
+    char *chunk = static_cast<char *>(std::malloc(size));
+    if (!chunk)
+        throw std::bad_alloc();
+    _chunks.push_back(chunk);
+    _cursor = chunk;
+    _end = chunk + size;
+    _nextChunkSize = size * 2;
+}
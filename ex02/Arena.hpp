@@ -0,0 +1,157 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Stack-like memory arena: allocation bumps a pointer inside the current
+// chunk, and deallocation only takes effect for the most recent allocation
+// (so scoped temporaries freed in reverse order are reused), everything
+// else is reclaimed when release() frees every chunk at once. Sized up
+// front, a whole computation costs one allocation call.
+class Arena
+{
+public:
+    Arena();
+    explicit Arena(size_t capacity);
+    ~Arena();
+
+    void *allocate(size_t bytes);
+    void deallocate(void *p, size_t bytes);
+    // Free every chunk; memory handed out before becomes invalid
+    void release();
+
+    // Bytes in use since construction or the last release(), and their
+    // maximum
+    size_t used() const;
+    size_t peak() const;
+    // Chunks allocated from the system since then
+    size_t chunks() const;
+
+private:
+    // Alignment of every allocation, enough for any scalar type
+    static const size_t ALIGNMENT = 16;
+    static const size_t MIN_CHUNK_SIZE = 4096;
+
+    std::vector<char *> _chunks;
+    char *_cursor;
+    char *_end;
+    size_t _nextChunkSize;
+    size_t _used;
+    size_t _peak;
+
+    static size_t _aligned(size_t bytes);
+    void _grow(size_t bytes);
+
+    Arena(Arena const &other);            // = delete;
+    Arena &operator=(Arena const &other); // = delete;
+};
+
+// Standard allocator drawing from an Arena. Copies, rebound copies
+// included, share the arena.
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef T const *const_pointer;
+    typedef T &reference;
+    typedef T const &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U> other;
+    };
+
+    ArenaAllocator() throw() : _arena(NULL)
+    {
+    }
+
+    explicit ArenaAllocator(Arena *arena) throw() : _arena(arena)
+    {
+    }
+
+    ArenaAllocator(ArenaAllocator const &other) throw()
+        : _arena(other._arena)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(ArenaAllocator<U> const &other) throw()
+        : _arena(other.arena())
+    {
+    }
+
+    ~ArenaAllocator() throw()
+    {
+    }
+
+    ArenaAllocator &operator=(ArenaAllocator const &other) throw()
+    {
+        _arena = other._arena;
+        return *this;
+    }
+
+    pointer address(reference x) const
+    {
+        return &x;
+    }
+
+    const_pointer address(const_reference x) const
+    {
+        return &x;
+    }
+
+    pointer allocate(size_type n, void const * = 0)
+    {
+        if (n > max_size())
+            throw std::bad_alloc();
+        return static_cast<pointer>(_arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type n)
+    {
+        _arena->deallocate(p, n * sizeof(T));
+    }
+
+    size_type max_size() const throw()
+    {
+        return static_cast<size_type>(-1) / sizeof(T);
+    }
+
+    void construct(pointer p, T const &value)
+    {
+        new (static_cast<void *>(p)) T(value);
+    }
+
+    void destroy(pointer p)
+    {
+        p->~T();
+    }
+
+    Arena *arena() const throw()
+    {
+        return _arena;
+    }
+
+private:
+    Arena *_arena;
+};
+
+template <typename T, typename U>
+bool operator==(ArenaAllocator<T> const &a, ArenaAllocator<U> const &b)
+{
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(ArenaAllocator<T> const &a, ArenaAllocator<U> const &b)
+{
+    return a.arena() != b.arena();
+}
+
+#endif /* ARENA_HPP */
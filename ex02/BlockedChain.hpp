@@ -0,0 +1,356 @@
+#ifndef BLOCKEDCHAIN_HPP
+#define BLOCKEDCHAIN_HPP
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Hint that `address` is about to be read, so that its cache line is
+// fetched while other work goes on (nothing where unsupported)
+inline void prefetchRead(void const *address)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+// Sequence stored as a list of blocks of the Block container (std::vector or
+// std::deque). Indexing finds the block by binary search over the block
+// start positions, and insertion only shifts elements inside one block plus
+// the start positions of the following blocks: O(sqrt n) instead of O(n).
+// The blocks and the index over them all come from the allocator of Block.
+template <typename T, typename Block>
+class BlockedChain
+{
+    typedef typename Block::allocator_type Allocator;
+    typedef typename Allocator::template rebind<Block>::other BlockAllocator;
+    typedef std::vector<Block *,
+        typename Allocator::template rebind<Block *>::other>
+        BlockList;
+    typedef std::vector<size_t,
+        typename Allocator::template rebind<size_t>::other>
+        StartList;
+    typedef std::vector<T, typename Allocator::template rebind<T>::other>
+        FrontList;
+
+public:
+    BlockedChain()
+        : _blocks(), _allocated(), _starts(), _fronts(), _size(0),
+          _blockSize(MIN_BLOCK_SIZE), _allocator()
+    {
+    }
+
+    // `expectedSize` is the size the chain will grow to, used to pick the
+    // block size. Blocks use the allocator of `elements`.
+    template <typename Container>
+    BlockedChain(Container const &elements, size_t expectedSize)
+        : _blocks(elements.get_allocator()),
+          _allocated(elements.get_allocator()),
+          _starts(elements.get_allocator()),
+          _fronts(elements.get_allocator()), _size(0),
+          _blockSize(MIN_BLOCK_SIZE), _allocator(elements.get_allocator())
+    {
+        while (_blockSize * _blockSize < expectedSize)
+            _blockSize *= 2;
+        // Blocks hold at least _blockSize elements once split, so the index
+        // never outgrows this, nor leaves holes in a stack-like allocator
+        size_t maxBlocks =
+            std::max(elements.size(), expectedSize) / _blockSize + 1;
+        _blocks.reserve(maxBlocks);
+        _allocated.reserve(maxBlocks);
+        _starts.reserve(maxBlocks);
+        _fronts.reserve(maxBlocks);
+        for (size_t i = 0; i < elements.size(); i += _blockSize)
+        {
+            size_t end = std::min(elements.size(), i + _blockSize);
+            _starts.push_back(i);
+            _fronts.push_back(elements[i]);
+            _blocks.push_back(_newBlock());
+            _blocks.back()->insert(_blocks.back()->end(),
+                elements.begin() + i, elements.begin() + end);
+        }
+        _size = elements.size();
+    }
+
+    ~BlockedChain()
+    {
+        _clear();
+    }
+
+    BlockedChain(BlockedChain const &other)
+        : _blocks(other._allocator), _allocated(other._allocator),
+          _starts(other._starts), _fronts(other._fronts), _size(other._size),
+          _blockSize(other._blockSize), _allocator(other._allocator)
+    {
+        for (size_t b = 0; b < other._blocks.size(); ++b)
+        {
+            _blocks.push_back(_newBlock());
+            *_blocks.back() = *other._blocks[b];
+        }
+    }
+
+    BlockedChain &operator=(BlockedChain const &other)
+    {
+        if (this != &other)
+        {
+            BlockedChain copy(other);
+            _blocks.swap(copy._blocks);
+            _allocated.swap(copy._allocated);
+            _starts.swap(copy._starts);
+            _fronts.swap(copy._fronts);
+            std::swap(_size, copy._size);
+            std::swap(_blockSize, copy._blockSize);
+            std::swap(_allocator, copy._allocator);
+        }
+        return *this;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    T const &operator[](size_t i) const
+    {
+        size_t b = _locate(i);
+        return (*_blocks[b])[i - _starts[b]];
+    }
+
+    // Address of element i. `block` is a guess of its block, from an
+    // element looked up before, and receives the right one: the search over
+    // the block starts is skipped while lookups stay in one block.
+    T const *find(size_t i, size_t &block) const
+    {
+        if (block >= _blocks.size() ||
+            i - _starts[block] >= _blocks[block]->size())
+            block = _locate(i);
+        return &(*_blocks[block])[i - _starts[block]];
+    }
+
+    // Prefetch element i, if it is in the chain. `block` is a guess of its
+    // block, as for find(); another block is searched for.
+    void prefetch(size_t i, size_t block) const
+    {
+        if (i >= _size)
+            return;
+        if (block >= _blocks.size() ||
+            i - _starts[block] >= _blocks[block]->size())
+            block = _locate(i);
+        prefetchRead(&(*_blocks[block])[i - _starts[block]]);
+    }
+
+    void insert(size_t pos, T const &value)
+    {
+        if (_blocks.empty())
+        {
+            _starts.push_back(0);
+            _fronts.push_back(value);
+            _blocks.push_back(_newBlock());
+        }
+        size_t b = pos < _size ? _locate(pos) : _blocks.size() - 1;
+        Block &block = *_blocks[b];
+        block.insert(block.begin() + (pos - _starts[b]), value);
+        if (pos == _starts[b])
+            _fronts[b] = value;
+        for (size_t k = b + 1; k < _starts.size(); ++k)
+            ++_starts[k];
+        ++_size;
+        if (block.size() >= 2 * _blockSize)
+            _split(b);
+    }
+
+    // Copy the elements, in order, into a container
+    template <typename Container>
+    void copyTo(Container &out) const
+    {
+        out.clear();
+        for (size_t b = 0; b < _blocks.size(); ++b)
+            out.insert(out.end(), _blocks[b]->begin(), _blocks[b]->end());
+    }
+
+private:
+    static const size_t MIN_BLOCK_SIZE = 64;
+
+    BlockList _blocks;
+    BlockList _allocated; // the same blocks, in allocation order
+    StartList _starts;    // index of the first element of each block
+    FrontList _fronts;    // copy of the first element of each block
+    size_t _size;
+    size_t _blockSize;
+    Allocator _allocator;
+
+    // Block of element i, the last one starting at or before i. The start
+    // comparisons select the next range with a mask instead of a branch,
+    // as in FordJohnson's _lowerBound(), so they cost no mispredictions.
+    size_t _locate(size_t i) const
+    {
+        size_t const *starts = &_starts[0];
+        size_t block = 0;
+        size_t count = _starts.size();
+        while (count > 1)
+        {
+            size_t half = count / 2;
+            size_t mask = 0 - static_cast<size_t>(starts[block + half] <= i);
+            block += half & mask;
+            count -= half;
+        }
+        return block;
+    }
+
+    void _split(size_t b)
+    {
+        Block &block = *_blocks[b];
+        size_t half = block.size() / 2;
+        Block *tail = _newBlock();
+        tail->insert(tail->end(), block.begin() + half, block.end());
+        block.erase(block.begin() + half, block.end());
+        _blocks.insert(_blocks.begin() + b + 1, tail);
+        _starts.insert(_starts.begin() + b + 1, _starts[b] + half);
+        _fronts.insert(_fronts.begin() + b + 1, (*tail)[0]);
+    }
+
+    // Empty block with room for the 2 * _blockSize elements it may reach
+    // before being split
+    Block *_newBlock()
+    {
+        BlockAllocator blocks(_allocator);
+        Block *block = blocks.allocate(1);
+        try
+        {
+            blocks.construct(block, Block(_allocator));
+        }
+        catch (...)
+        {
+            blocks.deallocate(block, 1);
+            throw;
+        }
+        _allocated.push_back(block);
+        _reserve(*block, 2 * _blockSize);
+        return block;
+    }
+
+    template <typename U, typename A>
+    static void _reserve(std::vector<U, A> &block, size_t n)
+    {
+        block.reserve(n);
+    }
+
+    template <typename Any>
+    static void _reserve(Any &, size_t)
+    {
+    }
+
+    // Blocks are freed in reverse order of allocation, which lets
+    // stack-like allocators reuse their memory
+    void _clear()
+    {
+        BlockAllocator blocks(_allocator);
+        for (size_t b = _allocated.size(); b > 0; --b)
+        {
+            blocks.destroy(_allocated[b - 1]);
+            blocks.deallocate(_allocated[b - 1], 1);
+        }
+        _blocks.clear();
+        _allocated.clear();
+        _starts.clear();
+        _fronts.clear();
+        _size = 0;
+    }
+};
+
+// Main chain view for the insertion phase backed by BlockedChains. The keys
+// and ids of the main chain, held in separate sequences, are split into
+// blocks once (both with the same layout) and written back by commit(); the
+// binary search only reads the keys.
+template <typename Key, typename KeySeq, typename Id, typename IdSeq>
+class BlockedMainChain
+{
+public:
+    BlockedMainChain(KeySeq &keys, IdSeq &ids, size_t insertions)
+        : _baseKeys(keys), _baseIds(ids),
+          _keys(keys, keys.size() + insertions),
+          _ids(ids, ids.size() + insertions)
+    {
+    }
+
+    ~BlockedMainChain()
+    {
+    }
+
+    size_t size() const
+    {
+        return _keys.size();
+    }
+
+    bool empty() const
+    {
+        return _keys.empty();
+    }
+
+    Key const &key(size_t pos) const
+    {
+        return _keys[pos];
+    }
+
+    Id id(size_t pos) const
+    {
+        return _ids[pos];
+    }
+
+    void insert(size_t pos, Key const &key, Id id)
+    {
+        _keys.insert(pos, key);
+        _ids.insert(pos, id);
+    }
+
+    // Binary search helper. It remembers the block of the last probe: once
+    // the search range fits in one block, probes and prefetches index it
+    // directly instead of searching the block starts, which they only do,
+    // without branches, for positions in other blocks.
+    class Search
+    {
+    public:
+        explicit Search(BlockedMainChain const &chain)
+            : _chain(chain), _block(0)
+        {
+        }
+
+        Key const &probe(size_t pos)
+        {
+            return *_chain._keys.find(pos, _block);
+        }
+
+        void prefetch(size_t pos) const
+        {
+            _chain._keys.prefetch(pos, _block);
+        }
+
+    private:
+        BlockedMainChain const &_chain;
+        size_t _block;
+    };
+
+    void commit()
+    {
+        _keys.copyTo(_baseKeys);
+        _ids.copyTo(_baseIds);
+    }
+
+private:
+    KeySeq &_baseKeys;
+    IdSeq &_baseIds;
+    BlockedChain<Key, KeySeq> _keys;
+    BlockedChain<Id, IdSeq> _ids;
+
+    BlockedMainChain();                                         // = delete;
+    BlockedMainChain(BlockedMainChain const &other);            // = delete;
+    BlockedMainChain &operator=(BlockedMainChain const &other); // = delete;
+};
+
+#endif /* BLOCKEDCHAIN_HPP */
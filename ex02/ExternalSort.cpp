@@ -0,0 +1,227 @@
+#include "ExternalSort.hpp"
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+#include "FordJohnson.hpp"
+
+const size_t ExternalSort::DEFAULT_MEMORY_BYTES;
+const size_t ExternalSort::MAX_MERGE_WAYS;
+const size_t ExternalSort::READ_BUFFER_ELEMENTS;
+const size_t ExternalSort::MERGE_BYTES =
+    MAX_MERGE_WAYS * READ_BUFFER_ELEMENTS * sizeof(int);
+
+// Merge outputs: a longer run, or the final text output
+struct ExternalSort::FileSink {
+    std::FILE *file;
+
+    explicit FileSink(std::FILE *f) : file(f) {}
+
+    void operator()(int value) {
+        if (std::fwrite(&value, sizeof(value), 1, file) != 1)
+            throw std::runtime_error("could not write a temporary file.");
+    }
+};
+
+struct ExternalSort::StreamSink {
+    std::ostream &output;
+
+    explicit StreamSink(std::ostream &o) : output(o) {}
+
+    void operator()(int value) {
+        output << value << '\n';
+    }
+};
+
+ExternalSort::ExternalSort(size_t chunkElements)
+    : _chunkElements(chunkElements > 0 ? chunkElements : 1),
+      _comparisons(0),
+      _runs(0),
+      _files() {}
+
+ExternalSort::~ExternalSort() {
+    _closeRuns();
+}
+
+size_t ExternalSort::chunkElementsFor(size_t memoryBytes) {
+    size_t perElement =
+        sizeof(int) + FordJohnson<std::vector, int>::scratchBytes(1);
+    return std::max(memoryBytes / perElement, static_cast<size_t>(1));
+}
+
+// ----------------------------------------------------------------
+// public member functions
+
+size_t ExternalSort::sort(std::istream &input, std::ostream &output) {
+    _comparisons = 0;
+    _runs = 0;
+    size_t total = 0;
+    try {
+        std::vector<int> chunk;
+        chunk.reserve(_chunkElements);
+        while (_readChunk(input, chunk)) {
+            total += chunk.size();
+            ++_runs;
+            _sortChunk(chunk);
+            input >> std::ws;
+            if (_files.empty() && input.eof()) {
+                // Fits in one chunk: nothing to spill
+                StreamSink sink(output);
+                for (size_t i = 0; i < chunk.size(); ++i)
+                    sink(chunk[i]);
+                break;
+            }
+            std::FILE *run = _createRun();
+            if (std::fwrite(&chunk[0], sizeof(int), chunk.size(), run) !=
+                chunk.size())
+                throw std::runtime_error("could not write a temporary file.");
+        }
+        std::vector<int>().swap(chunk);  // freed before the read buffers
+
+        while (_files.size() > MAX_MERGE_WAYS) {
+            size_t count = _files.size();
+            for (size_t first = 0; first < count; first += MAX_MERGE_WAYS) {
+                FileSink sink(_createRun());
+                _merge(first, std::min(first + MAX_MERGE_WAYS, count), sink);
+            }
+            _files.erase(std::remove(_files.begin(), _files.end(),
+                             static_cast<std::FILE *>(NULL)),
+                _files.end());
+        }
+        StreamSink sink(output);
+        _merge(0, _files.size(), sink);
+        _files.clear();
+    } catch (...) {
+        _closeRuns();
+        throw;
+    }
+    output.flush();
+    if (!output)
+        throw std::runtime_error("could not write the output.");
+    return total;
+}
+
+size_t ExternalSort::comparisons() const {
+    return _comparisons;
+}
+
+size_t ExternalSort::runs() const {
+    return _runs;
+}
+
+// ----------------------------------------------------------------
+// private member functions
+
+// Next chunk of the input, false at its end. Only whitespace may follow
+// the last integer: a token that fails to parse, at the end as anywhere
+// else, is an error.
+bool ExternalSort::_readChunk(std::istream &input, std::vector<int> &chunk) {
+    chunk.clear();
+    int value;
+    while (chunk.size() < _chunkElements && !(input >> std::ws).eof()) {
+        if (!(input >> value))
+            throw std::invalid_argument("invalid integer in the input.");
+        chunk.push_back(value);
+    }
+    return !chunk.empty();
+}
+
+void ExternalSort::_sortChunk(std::vector<int> &chunk) {
+    FordJohnson<std::vector, int> engine("External ");
+    engine.setRunDetection(true);
+    engine.sort(chunk.begin(), chunk.end());
+    _comparisons += engine.comparisons();
+}
+
+// Empty temporary file for a run, deleted once closed
+std::FILE *ExternalSort::_createRun() {
+    std::FILE *file = std::tmpfile();
+    if (file == NULL)
+        throw std::runtime_error("could not create a temporary file.");
+    _files.push_back(file);
+    return file;
+}
+
+// Merge the runs _files[first..last) into `sink`, then close them. The
+// loser tree keeps, in each internal node, the run that lost the match
+// played there, and the overall winner in tree[0]: once its head is out,
+// its next element only replays the matches on its path to the root.
+template <typename Sink>
+void ExternalSort::_merge(size_t first, size_t last, Sink &sink) {
+    size_t k = last - first;
+    if (k == 0)
+        return;
+    std::vector<Source> sources(k);
+    for (size_t i = 0; i < k; ++i) {
+        sources[i].file = _files[first + i];
+        std::rewind(sources[i].file);
+        _refill(sources[i]);
+    }
+
+    // Run i is leaf k + i; node n has children 2n and 2n + 1
+    std::vector<size_t> tree(k, 0);
+    std::vector<size_t> winners(2 * k, 0);
+    for (size_t i = 0; i < k; ++i)
+        winners[k + i] = i;
+    for (size_t node = k - 1; node > 0; --node) {
+        size_t a = winners[2 * node];
+        size_t b = winners[2 * node + 1];
+        bool bWins = _less(sources, b, a);
+        winners[node] = bWins ? b : a;
+        tree[node] = bWins ? a : b;
+    }
+    tree[0] = k > 1 ? winners[1] : 0;
+
+    for (;;) {
+        size_t current = tree[0];
+        Source &source = sources[current];
+        if (source.next == source.buffer.size())
+            break;  // the winner is exhausted: so are all the others
+        sink(source.buffer[source.next]);
+        if (++source.next == source.buffer.size())
+            _refill(source);
+        for (size_t node = (k + current) / 2; node > 0; node /= 2) {
+            if (_less(sources, tree[node], current))
+                std::swap(tree[node], current);
+        }
+        tree[0] = current;
+    }
+
+    for (size_t i = first; i < last; ++i) {
+        std::fclose(_files[i]);
+        _files[i] = NULL;
+    }
+}
+
+void ExternalSort::_refill(Source &source) {
+    source.buffer.resize(READ_BUFFER_ELEMENTS);
+    size_t count = std::fread(
+        &source.buffer[0], sizeof(int), READ_BUFFER_ELEMENTS, source.file);
+    if (std::ferror(source.file))
+        throw std::runtime_error("could not read a temporary file.");
+    source.buffer.resize(count);
+    source.next = 0;
+}
+
+// Whether the head of run a orders before that of run b; exhausted runs
+// order last, without a comparison
+bool ExternalSort::_less(
+    std::vector<Source> const &sources, size_t a, size_t b) {
+    bool aDone = sources[a].next == sources[a].buffer.size();
+    bool bDone = sources[b].next == sources[b].buffer.size();
+    if (aDone || bDone)
+        return !aDone;
+    ++_comparisons;
+    return sources[a].buffer[sources[a].next] <
+           sources[b].buffer[sources[b].next];
+}
+
+void ExternalSort::_closeRuns() {
+    for (size_t i = 0; i < _files.size(); ++i) {
+        if (_files[i] != NULL)
+            std::fclose(_files[i]);
+    }
+    _files.clear();
+}
@@ -0,0 +1,77 @@
+#ifndef EXTERNALSORT_HPP
+#define EXTERNALSORT_HPP
+#include <cstddef>
+#include <cstdio>
+#include <iosfwd>
+#include <vector>
+
+// Out-of-core sort of integers. The input is read chunkElements at a time;
+// each chunk is sorted in place by FordJohnson and spilled to a temporary
+// file as a sorted run. The runs are then merged through a loser tree, about
+// log2(k) comparisons per element for k runs, straight into the output. When
+// there are more runs than can be merged at once, groups of them are first
+// merged into longer runs. Memory peaks while a chunk is sorted: the chunk
+// plus FordJohnson's scratch, FordJohnson::scratchBytes(chunkElements), about
+// 20 times the chunk itself. Merging needs one read buffer per run merged,
+// MERGE_BYTES at most.
+class ExternalSort
+{
+public:
+    // Memory budget of `PmergeMe --file`
+    static const size_t DEFAULT_MEMORY_BYTES = 64 << 20;
+    // Read buffers of the runs merged at once
+    static const size_t MERGE_BYTES;
+
+    explicit ExternalSort(size_t chunkElements);
+
+    // Largest chunkElements whose sort fits in `memoryBytes`, at least 1
+    static size_t chunkElementsFor(size_t memoryBytes);
+    ~ExternalSort();
+
+    // Read whitespace-separated integers from `input` up to its end and
+    // write them sorted to `output`, one per line; returns their number.
+    // Throws std::invalid_argument when the input holds anything else, and
+    // std::runtime_error when a temporary file or the output fails.
+    size_t sort(std::istream &input, std::ostream &output);
+
+    // Of the last sort(): comparisons made sorting chunks and merging them,
+    // and sorted runs the input was cut into
+    size_t comparisons() const;
+    size_t runs() const;
+
+private:
+    // Runs merged at once, each with a read buffer of READ_BUFFER_ELEMENTS
+    static const size_t MAX_MERGE_WAYS = 256;
+    static const size_t READ_BUFFER_ELEMENTS = 4096;
+
+    // A sorted run being merged, read back through a buffer
+    struct Source
+    {
+        std::FILE *file;
+        std::vector<int> buffer;
+        size_t next;
+    };
+
+    struct FileSink;
+    struct StreamSink;
+
+    size_t _chunkElements;
+    size_t _comparisons;
+    size_t _runs;
+    std::vector<std::FILE *> _files; // open runs, NULL once merged
+
+    bool _readChunk(std::istream &input, std::vector<int> &chunk);
+    void _sortChunk(std::vector<int> &chunk);
+    std::FILE *_createRun();
+    template <typename Sink>
+    void _merge(size_t first, size_t last, Sink &sink);
+    void _refill(Source &source);
+    bool _less(std::vector<Source> const &sources, size_t a, size_t b);
+    void _closeRuns();
+
+    ExternalSort();                                     // = delete;
+    ExternalSort(ExternalSort const &other);            // = delete;
+    ExternalSort &operator=(ExternalSort const &other); // = delete;
+};
+
+#endif /* EXTERNALSORT_HPP */
@@ -0,0 +1,1627 @@
+#ifndef FORDJOHNSON_HPP
+#define FORDJOHNSON_HPP
+#include <stdint.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Arena.hpp"
+#include "BlockedChain.hpp"
+#include "PairKernel.hpp"
+#include "ThreadPool.hpp"
+
+// Main chain view used by FordJohnson's insertion phase for the key and id
+// sequences of a main chain. There is one backend, the blocked chain, for
+// every sequence; the trait is where a container-specific one would be
+// plugged in. A chain provides size(), empty(), key(), id(), insert(),
+// commit() and a Search helper with probe() and prefetch() (see
+// BlockedMainChain).
+template <typename KeySeq, typename IdSeq>
+struct InsertionChain
+{
+    typedef BlockedMainChain<typename KeySeq::value_type, KeySeq,
+        typename IdSeq::value_type, IdSeq>
+        type;
+};
+
+// Comparison counting policies of FordJohnson. ComparisonCounter counts the
+// comparisons of a sort() call; NoComparisonCounter does nothing, so the
+// counting compiles away.
+struct ComparisonCounter
+{
+    size_t comparisons;
+
+    ComparisonCounter() : comparisons(0)
+    {
+    }
+
+    void add(size_t n)
+    {
+        comparisons += n;
+    }
+
+    size_t count() const
+    {
+        return comparisons;
+    }
+};
+
+struct NoComparisonCounter
+{
+    void add(size_t)
+    {
+    }
+
+    size_t count() const
+    {
+        return 0;
+    }
+};
+
+// One comparison of a batch: `less` receives whether *left orders before
+// *right
+template <typename T>
+struct BatchedComparison
+{
+    T const *left;
+    T const *right;
+    bool less;
+};
+
+// Base of comparators that can resolve several independent comparisons in
+// one call, to amortize a per-call latency (a remote service, a person
+// ranking items). Besides bool operator()(T const &, T const &), derived
+// classes define
+//     void operator()(BatchedComparison<T> *batch, size_t count);
+// FordJohnson hands them the pair comparisons of each level as one batch
+// (one per chunk of pairs on parallel levels), in the order it would make
+// them one by one.
+template <typename T>
+struct BatchComparator
+{
+    typedef BatchedComparison<T> Comparison;
+};
+
+// Reorder `elements` in place so that elements[i] becomes the element at
+// permutation[i] (as returned by FordJohnson::argsort()), by following the
+// cycles of the permutation with swaps: wide records are not copied, and
+// parallel arrays can all be sorted by one key array. Throws
+// std::invalid_argument, before moving anything, if `permutation` is not a
+// permutation of the indices of `elements`.
+template <typename RandomAccess>
+void applyPermutation(
+    RandomAccess &elements, std::vector<size_t> const &permutation)
+{
+    size_t n = permutation.size();
+    if (n != elements.size())
+        throw std::invalid_argument("permutation size mismatch");
+    std::vector<bool> placed(n, false);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (permutation[i] >= n || placed[permutation[i]])
+            throw std::invalid_argument("not a permutation");
+        placed[permutation[i]] = true;
+    }
+    placed.assign(n, false);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (placed[i])
+            continue;
+        // elements[i] is moved along its cycle until its own slot comes up
+        size_t j = i;
+        placed[j] = true;
+        while (permutation[j] != i)
+        {
+            using std::swap;
+            swap(elements[j], elements[permutation[j]]);
+            j = permutation[j];
+            placed[j] = true;
+        }
+    }
+}
+
+// Ford-Johnson merge-insertion sort over a random-access Sequence
+// (std::vector, std::deque) of T ordered by Compare; the result uses Alloc,
+// and Counter is the comparison counting policy.
+// Every temporary sequence the algorithm builds is a Sequence too, so each
+// backend keeps its own memory behaviour, but is carved from one Arena per
+// sort() call that is released at once when the sort returns.
+//
+// Data is kept as structure of arrays: keys are stored densely, and each
+// element of a recursion level is identified by its 32-bit index in that
+// level, kept in separate sequences. Binary searches only read keys.
+//
+// With more than one thread (setThreads()), levels of at least
+// PARALLEL_MIN_ELEMENTS elements run on a ThreadPool: the pairs are compared
+// in parallel, and every pending element is then searched independently
+// among the larger elements only, up to its partner; the elements landing
+// in the same gap are ordered last, a block sort per gap and then parallel
+// merges for the large ones. The sorted keys are the same for any number of
+// threads, at the cost of a few more comparisons than the sequential
+// insertion order; equal keys may come out in another order, so argsort()
+// ids for them can differ from the sequential ones (not with `stable`).
+// Compare must be callable from several threads at once and must not throw.
+//
+// Sequential levels make at most worstCaseComparisons(n) comparisons, the
+// Ford-Johnson bound.
+//
+// With run detection on (setRunDetection()), sort() first splits the input
+// into ascending and strictly descending runs: sorted or reversed input
+// then costs n - 1 comparisons, and a few runs are merged instead of sorted
+// (see _sortRuns()). Inputs with too many runs fall back to Ford-Johnson,
+// having spent the comparisons of the scan on top of its bound.
+//
+// With duplicate collapsing on (setDuplicateCollapsing()), equal elements
+// are grouped as they are read, and only one per group is inserted among
+// the distinct keys found so far: about log2(k) + 1 comparisons per element
+// for k distinct keys. Once more than n / DUPLICATE_FACTOR keys turn out
+// distinct, grouping cannot beat Ford-Johnson any more and it takes over.
+//
+// In DEBUG builds every comparison of the sequential levels is printed,
+// prefixed by the label, so T must then be printable.
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare = std::less<T>, typename Alloc = std::allocator<T>,
+    typename Counter = ComparisonCounter>
+class FordJohnson
+{
+public:
+    typedef Sequence<T, Alloc> Container;
+
+    FordJohnson()
+        : _comp(), _label(), _counter(), _threads(1), _runDetection(false),
+          _duplicateCollapsing(false), _scratch(), _pool(NULL),
+          _workerCounters()
+    {
+    }
+
+    explicit FordJohnson(
+        std::string const &label, Compare const &comp = Compare())
+        : _comp(comp), _label(label), _counter(), _threads(1),
+          _runDetection(false), _duplicateCollapsing(false), _scratch(),
+          _pool(NULL), _workerCounters()
+    {
+    }
+
+    ~FordJohnson()
+    {
+    }
+
+    FordJohnson(FordJohnson const &other)
+        : _comp(other._comp), _label(other._label),
+          _counter(other._counter), _threads(other._threads),
+          _runDetection(other._runDetection),
+          _duplicateCollapsing(other._duplicateCollapsing), _scratch(),
+          _pool(NULL), _workerCounters()
+    {
+    }
+
+    FordJohnson &operator=(FordJohnson const &other)
+    {
+        if (this != &other)
+        {
+            _comp = other._comp;
+            _label = other._label;
+            _counter = other._counter;
+            _threads = other._threads;
+            _runDetection = other._runDetection;
+            _duplicateCollapsing = other._duplicateCollapsing;
+        }
+        return *this;
+    }
+
+    // Sorted copy of `input`
+    Container sort(Container const &input)
+    {
+        Container result(input.get_allocator());
+        _reserve(result, input.size());
+        KeySink<std::back_insert_iterator<Container> > sink(
+            std::back_inserter(result));
+        _sortInput(input, sink, false, input.size());
+        return result;
+    }
+
+    // Sort the caller's [first, last) in place; only the scratch of the
+    // Sequence backend is allocated, no copy of the input or the result
+    template <typename RandomAccessIterator>
+    void sort(RandomAccessIterator first, RandomAccessIterator last)
+    {
+        sort(first, last, first);
+    }
+
+    // Write [first, last) sorted to `out`, which may be `first`, and return
+    // the end of the output
+    template <typename RandomAccessIterator, typename OutputIterator>
+    OutputIterator sort(RandomAccessIterator first, RandomAccessIterator last,
+        OutputIterator out)
+    {
+        KeySink<OutputIterator> sink(out);
+        Range<RandomAccessIterator> range(first, last);
+        _sortInput(range, sink, false, range.size());
+        return sink.out;
+    }
+
+    // Sorting permutation of `input`: the index in `input` of each element
+    // of sort(input), in order. With `stable`, equal elements keep their
+    // input order, for up to n - 1 more comparisons.
+    std::vector<size_t> argsort(Container const &input, bool stable = false)
+    {
+        std::vector<size_t> permutation;
+        PermutationSink sink(permutation);
+        _sortInput(input, sink, stable, input.size());
+        return permutation;
+    }
+
+    // Merge `batch` into `sorted`, already ordered by Compare. The batch is
+    // sorted on its own, then merged in from the back by Hwang and Lin's
+    // binary merge (see _binaryMerge()): m new elements cost about
+    // m log2(n / m) + m comparisons on top of sorting them, and only the
+    // elements after the first insertion point move. New elements go after
+    // equal ones already there; comparisons() counts both steps.
+    void insert(Container &sorted, Container const &batch)
+    {
+        Container sortedBatch = sort(batch);
+        if (sortedBatch.empty())
+            return;
+        size_t n = sorted.size();
+        sorted.resize(n + sortedBatch.size(), sortedBatch[0]);
+        InsertMerge merge(sorted, sortedBatch);
+        _binaryMerge(merge, n, sortedBatch.size());
+    }
+
+    // The smallest min(k, n) elements of `input`, sorted. Pairing prunes
+    // every element with k smaller ones before any insertion, so for k
+    // much smaller than n this costs about n + k log2(k) log2(n / k)
+    // comparisons instead of n log2(n).
+    Container partialSort(Container const &input, size_t k)
+    {
+        Container result(input.get_allocator());
+        _reserve(result, std::min(k, input.size()));
+        KeySink<std::back_insert_iterator<Container> > sink(
+            std::back_inserter(result));
+        _sortInput(input, sink, false, k);
+        return result;
+    }
+
+    // Comparisons made by the last sort() call (0 with NoComparisonCounter)
+    size_t comparisons() const
+    {
+        return _counter.count();
+    }
+
+    // F(n), the most comparisons Ford-Johnson needs to sort n elements: the
+    // sum for k = 1..n of ceil(log2(3k / 4))
+    static size_t worstCaseComparisons(size_t n)
+    {
+        size_t sum = 0;
+        size_t log = 0;
+        for (size_t k = 1; k <= n; ++k)
+        {
+            while ((static_cast<size_t>(4) << log) < 3 * k)
+                ++log;
+            sum += log;
+        }
+        return sum;
+    }
+
+    // Bytes of scratch arena a sort of n elements reserves up front, on top
+    // of its input and result. Each level needs about SCRATCH_PER_ELEMENT
+    // bytes per element it sorts, and level sizes halve, so the levels
+    // together need at most twice that of the first one. With std::vector,
+    // scratch is freed in stack order and about half of it is in use at
+    // once; std::deque frees its nodes out of order.
+    static size_t scratchBytes(size_t n)
+    {
+        return 2 * SCRATCH_PER_ELEMENT * n;
+    }
+
+    // Threads used by sort(), the calling one included (1: sequential)
+    void setThreads(size_t threads)
+    {
+        _threads = threads > 0 ? threads : 1;
+    }
+
+    size_t threads() const
+    {
+        return _threads;
+    }
+
+    // Scan for sorted runs before sorting (off by default: Ford-Johnson
+    // alone keeps the worstCaseComparisons() bound)
+    void setRunDetection(bool enabled)
+    {
+        _runDetection = enabled;
+    }
+
+    bool runDetection() const
+    {
+        return _runDetection;
+    }
+
+    // Group equal elements before sorting (off by default: it only pays off
+    // when keys repeat several times each)
+    void setDuplicateCollapsing(bool enabled)
+    {
+        _duplicateCollapsing = enabled;
+    }
+
+    bool duplicateCollapsing() const
+    {
+        return _duplicateCollapsing;
+    }
+
+private:
+    template <typename U>
+    struct Rebind
+    {
+        typedef Sequence<U, ArenaAllocator<U> > type;
+    };
+
+    typedef uint32_t Id; // index of an element in its recursion level
+    typedef typename Rebind<T>::type KeySeq;
+    typedef typename Rebind<Id>::type IdSeq;
+
+    typedef typename InsertionChain<KeySeq, IdSeq>::type Chain;
+    // Comparisons handed to a BatchComparator as one array, whatever the
+    // Sequence
+    typedef std::vector<BatchedComparison<T>,
+        ArenaAllocator<BatchedComparison<T> > >
+        ComparisonBatch;
+
+    static const Id NO_ID = static_cast<Id>(-1);
+    static const size_t MAX_ELEMENTS = NO_ID;
+
+    // Scratch bytes per element of a recursion level: main chain and its
+    // blocks, larger and pending elements, gap bookkeeping
+    static const size_t SCRATCH_PER_ELEMENT =
+        4 * (sizeof(T) + sizeof(Id)) + 2 * sizeof(Id);
+
+    // Smallest level sorted in parallel, and indices per parallel chunk:
+    // below that, handing work to other threads costs more than it saves
+    static const size_t PARALLEL_MIN_ELEMENTS = 2048;
+    static const size_t PARALLEL_GRAIN = 512;
+
+    // Least number of elements per distinct key for which grouping equal
+    // elements beats Ford-Johnson: log2(n / 8) + 1 comparisons per element
+    // against about log2(n) - 1.4
+    static const size_t DUPLICATE_FACTOR = 8;
+
+    Compare _comp;
+    std::string _label;
+    Counter _counter;
+    size_t _threads;
+    bool _runDetection;
+    bool _duplicateCollapsing;
+    ArenaAllocator<char> _scratch; // arena of the running sort()
+    ThreadPool *_pool;             // pool of the running sort(), if parallel
+    std::vector<Counter> _workerCounters; // of each pool worker
+
+    // Read-only view of [first, last) with the interface of a sequence
+    template <typename Iterator>
+    class Range
+    {
+    public:
+        Range(Iterator first, Iterator last) : _first(first), _last(last)
+        {
+        }
+
+        size_t size() const
+        {
+            return static_cast<size_t>(_last - _first);
+        }
+
+        bool empty() const
+        {
+            return _first == _last;
+        }
+
+        T const &operator[](size_t i) const
+        {
+            return _first[i];
+        }
+
+        Iterator begin() const
+        {
+            return _first;
+        }
+
+        Iterator end() const
+        {
+            return _last;
+        }
+
+    private:
+        Iterator _first;
+        Iterator _last;
+    };
+
+    // Receivers of the result of _sortInput(): the sorted keys, written to
+    // an output iterator, or their input indices
+    template <typename OutputIterator>
+    struct KeySink
+    {
+        OutputIterator out;
+
+        explicit KeySink(OutputIterator o) : out(o)
+        {
+        }
+
+        void operator()(KeySeq const &keys, IdSeq const &)
+        {
+            out = std::copy(keys.begin(), keys.end(), out);
+        }
+    };
+
+    struct PermutationSink
+    {
+        std::vector<size_t> &permutation;
+
+        explicit PermutationSink(std::vector<size_t> &p) : permutation(p)
+        {
+        }
+
+        void operator()(KeySeq const &, IdSeq const &ids)
+        {
+            permutation.assign(ids.begin(), ids.end());
+        }
+    };
+
+    // Driver of the public sorts: sort `input` (a Container or a Range), or
+    // only its smallest `limit` elements, and hand the sorted keys and ids
+    // to `sink` before the scratch goes
+    template <typename Input, typename Sink>
+    void _sortInput(Input const &input, Sink &sink, bool stable, size_t limit)
+    {
+        _counter = Counter();
+        if (input.empty() || limit == 0)
+            return;
+        if (input.size() > MAX_ELEMENTS)
+            throw std::length_error("too many elements");
+
+        Arena arena(scratchBytes(input.size()));
+        _scratch = ArenaAllocator<char>(&arena);
+        ThreadPool pool(input.size() >= PARALLEL_MIN_ELEMENTS ? _threads : 1);
+        _pool = pool.workers() > 1 ? &pool : NULL;
+        _workerCounters.assign(pool.workers(), Counter());
+        {
+            KeySeq keys(_scratch);
+            IdSeq ids(_scratch);
+            bool sorted = false;
+            if (limit < input.size())
+            {
+                _selectSmallest(input, limit, keys, ids);
+                sorted = true;
+            }
+            // Runs and groups of equal elements both keep input order
+            if (!sorted && _runDetection)
+                sorted = _sortRuns(input, keys, ids);
+            if (!sorted && _duplicateCollapsing)
+                sorted = _sortDistinct(input, keys, ids);
+            if (!sorted)
+            {
+                _sort(input, keys, ids);
+                if (stable)
+                    _stabilize(input, keys, ids);
+            }
+
+            sink(keys, ids);
+        }
+        for (size_t w = 0; w < _workerCounters.size(); ++w)
+            _counter.add(_workerCounters[w].count());
+        _pool = NULL;
+        _scratch = ArenaAllocator<char>();
+    }
+
+    // Put the elements of sorted `keys` equal to their neighbours back in
+    // input order: n - 1 comparisons find them, then their ids are sorted
+    template <typename Input>
+    void _stabilize(Input const &input, KeySeq &keys, IdSeq &ids)
+    {
+        size_t first = 0;
+        for (size_t i = 1; i <= keys.size(); ++i)
+        {
+            if (i < keys.size())
+            {
+                _printCompare(keys[i - 1], keys[i]);
+                if (!_comp(keys[i - 1], keys[i]))
+                    continue;
+            }
+            if (i - first > 1)
+            {
+                std::sort(ids.begin() + first, ids.begin() + i);
+                for (size_t k = first; k < i; ++k)
+                    keys[k] = input[ids[k]];
+            }
+            first = i;
+        }
+    }
+
+    // Sort `keys` into the empty `mainKeys`; `mainIds` receives the index in
+    // `keys` of every sorted element.
+    //
+    // The element of a pair that compares larger has id 2i or 2i + 1, and
+    // its smaller partner the other one: larger ^ 1.
+    template <typename Keys>
+    void _sort(Keys const &keys, KeySeq &mainKeys, IdSeq &mainIds)
+    {
+        size_t n = keys.size();
+        // The result and pending elements are allocated before the scratch
+        // of this level (and of the levels below), which is then freed in
+        // reverse order and reused by the insertion phase
+        _reserve(mainKeys, n);
+        _reserve(mainIds, n);
+        if (n <= 1)
+        {
+            mainKeys.insert(mainKeys.end(), keys.begin(), keys.end());
+            mainIds.insert(mainIds.end(), n, 0);
+            return;
+        }
+        if (_pool && n >= PARALLEL_MIN_ELEMENTS)
+        {
+            _sortParallel(keys, mainKeys, mainIds);
+            return;
+        }
+
+        size_t pairCount = n / 2;
+        bool hasOddElement = n % 2 == 1;
+        KeySeq pendingKeys(_scratch);
+        IdSeq pendingIds(_scratch);
+        _reserve(pendingKeys, n - pairCount);
+        _reserve(pendingIds, n - pairCount);
+        {
+            // Step 1: Compare pairs, keeping the larger key and id of each
+            KeySeq largerKeys(pairCount, keys[0], _scratch);
+            IdSeq largerIds(pairCount, 0, _scratch);
+            for (size_t i = 0; i < pairCount; ++i)
+                _printCompare(keys[2 * i], keys[2 * i + 1]);
+            {
+                ComparisonBatch batch(_scratch);
+                _sizeBatch(batch, pairCount, &_comp);
+                _comparePairs(keys, 0, pairCount, largerKeys, largerIds,
+                    batch, &_comp);
+            }
+
+            if (pairCount == 1 && !hasOddElement)
+            {
+                // Only one pair to sort
+                mainKeys.push_back(keys[largerIds[0] ^ 1]);
+                mainIds.push_back(largerIds[0] ^ 1);
+                mainKeys.push_back(largerKeys[0]);
+                mainIds.push_back(largerIds[0]);
+                return;
+            }
+
+            // Step 2: Sort the larger elements, their ids are pair indices
+            _sort(largerKeys, mainKeys, mainIds);
+
+            // Step 3: The sorted larger elements form the main chain, and
+            // their smaller partners are pending in the same order
+            for (size_t k = 0; k < mainIds.size(); ++k)
+            {
+                Id larger = largerIds[mainIds[k]];
+                mainIds[k] = larger;
+                pendingKeys.push_back(keys[larger ^ 1]);
+                pendingIds.push_back(larger ^ 1);
+            }
+        }
+        _printMainChain(mainKeys);
+
+        if (hasOddElement)
+        {
+            pendingKeys.push_back(keys[n - 1]);
+            pendingIds.push_back(static_cast<Id>(n - 1));
+        }
+        _printPending(pendingKeys);
+
+        // Step 4: Insert smaller elements using Ford-Johnson order
+        _insertWithJacobsthalOrder(mainKeys, mainIds, pendingKeys, pendingIds);
+    }
+
+    // Smallest k (> 0) of `keys`, sorted, into the empty `mainKeys`, with
+    // their indices in `keys` in `mainIds`. The pairs are compared as in
+    // _sort(), and the smallest k of their smaller elements (plus the odd
+    // one) are selected recursively: any other element has k smaller ones
+    // and is dropped with its whole pair. The partners of the selected
+    // elements are then inserted from the last one down, so that the
+    // partner of the r-th is searched right after it, at r + 1, and only
+    // up to the k-th element: landing beyond it, it is dropped as well.
+    template <typename Keys>
+    void _selectSmallest(
+        Keys const &keys, size_t k, KeySeq &mainKeys, IdSeq &mainIds)
+    {
+        size_t n = keys.size();
+        if (k >= n)
+        {
+            _sort(keys, mainKeys, mainIds);
+            return;
+        }
+
+        size_t pairCount = n / 2;
+        _reserve(mainKeys, 2 * k);
+        _reserve(mainIds, 2 * k);
+        // Partner of each selected element by rank (NO_ID for the odd one)
+        KeySeq partnerKeys(_scratch);
+        IdSeq partnerIds(_scratch);
+        _reserve(partnerKeys, k);
+        _reserve(partnerIds, k);
+        {
+            KeySeq largerKeys(pairCount, keys[0], _scratch);
+            IdSeq largerIds(pairCount, 0, _scratch);
+            for (size_t i = 0; i < pairCount; ++i)
+                _printCompare(keys[2 * i], keys[2 * i + 1]);
+            {
+                ComparisonBatch batch(_scratch);
+                _sizeBatch(batch, pairCount, &_comp);
+                _comparePairs(keys, 0, pairCount, largerKeys, largerIds,
+                    batch, &_comp);
+            }
+
+            KeySeq smallerKeys(_scratch);
+            _reserve(smallerKeys, n - pairCount);
+            for (size_t i = 0; i < pairCount; ++i)
+                smallerKeys.push_back(keys[largerIds[i] ^ 1]);
+            if (n % 2 == 1)
+                smallerKeys.push_back(keys[n - 1]);
+            _selectSmallest(smallerKeys, k, mainKeys, mainIds);
+
+            for (size_t r = 0; r < mainIds.size(); ++r)
+            {
+                size_t pair = mainIds[r];
+                bool paired = pair < pairCount;
+                mainIds[r] = paired ? largerIds[pair] ^ 1
+                                    : static_cast<Id>(n - 1);
+                partnerKeys.push_back(paired ? largerKeys[pair] : keys[0]);
+                partnerIds.push_back(paired ? largerIds[pair] : NO_ID);
+            }
+        }
+        _printMainChain(mainKeys);
+
+        size_t selected = mainKeys.size();
+        {
+            Chain chain(mainKeys, mainIds, selected);
+            for (size_t r = selected; r-- > 0;)
+            {
+                if (partnerIds[r] == NO_ID)
+                    continue;
+                size_t last = std::min(k, chain.size());
+                size_t pos = _lowerBound(chain, partnerKeys[r], r + 1, last);
+                if (pos >= k)
+                    continue;
+                chain.insert(pos, partnerKeys[r], partnerIds[r]);
+                _printMainChain(chain);
+            }
+            chain.commit();
+        }
+        if (mainKeys.size() > k)
+        {
+            mainKeys.erase(mainKeys.begin() + k, mainKeys.end());
+            mainIds.erase(mainIds.begin() + k, mainIds.end());
+        }
+    }
+
+    // _sort() for a level on the thread pool. Pending element j is the
+    // partner of main chain element j (or the odd element, j == pairCount):
+    // its gap, the number of larger elements before it, only depends on the
+    // larger elements, so all of them are searched at once. Each gap then
+    // gets its pending elements and is sorted on its own.
+    template <typename Keys>
+    void _sortParallel(Keys const &keys, KeySeq &mainKeys, IdSeq &mainIds)
+    {
+        size_t n = keys.size();
+        size_t pairCount = n / 2;
+        size_t pendingCount = n - pairCount;
+        IdSeq pendingIds(pendingCount, 0, _scratch);
+        IdSeq gaps(pendingCount, 0, _scratch);
+        {
+            // Step 1: Compare pairs, keeping the larger key and id of each
+            KeySeq largerKeys(pairCount, keys[0], _scratch);
+            IdSeq largerIds(pairCount, 0, _scratch);
+            {
+                ComparisonBatch batch(_scratch);
+                _sizeBatch(batch, pairCount, &_comp);
+                PairTask<Keys> pairs(*this, keys, largerKeys, largerIds,
+                    batch);
+                _pool->parallelFor(pairs, pairCount, PARALLEL_GRAIN);
+            }
+
+            // Step 2: Sort the larger elements, their ids are pair indices
+            _sort(largerKeys, mainKeys, mainIds);
+
+            // Step 3: Main chain and pending elements, as in _sort()
+            for (size_t k = 0; k < pairCount; ++k)
+            {
+                Id larger = largerIds[mainIds[k]];
+                mainIds[k] = larger;
+                pendingIds[k] = larger ^ 1;
+            }
+        }
+        if (pendingCount > pairCount)
+            pendingIds[pairCount] = static_cast<Id>(n - 1);
+
+        // Step 4: Find the gap of every pending element
+        SearchTask<Keys> search(*this, keys, mainKeys, pendingIds, gaps);
+        _pool->parallelFor(search, pendingCount, PARALLEL_GRAIN);
+
+        // Pending elements grouped by gap, in pending order: those of gap g
+        // are order[starts[g]..starts[g + 1])
+        IdSeq starts(pairCount + 3, 0, _scratch);
+        IdSeq order(pendingCount, 0, _scratch);
+        for (size_t j = 0; j < pendingCount; ++j)
+            ++starts[gaps[j] + 2];
+        for (size_t g = 2; g < starts.size(); ++g)
+            starts[g] += starts[g - 1];
+        for (size_t j = 0; j < pendingCount; ++j)
+            order[starts[gaps[j] + 1]++] = static_cast<Id>(j);
+
+        // Step 5: Spread the main chain in place, from the last gap down:
+        // gap g starts at g + starts[g] >= g, so no element is overwritten
+        // before it has moved
+        mainKeys.resize(n, keys[0]);
+        mainIds.resize(n, 0);
+        for (size_t g = pairCount + 1; g-- > 0;)
+        {
+            size_t end = g + starts[g + 1];
+            if (g < pairCount)
+            {
+                mainKeys[end] = mainKeys[g];
+                mainIds[end] = mainIds[g];
+            }
+            for (size_t k = starts[g]; k < starts[g + 1]; ++k)
+            {
+                Id id = pendingIds[order[k]];
+                mainKeys[g + k] = keys[id];
+                mainIds[g + k] = id;
+            }
+        }
+
+        // Step 6: Sort the pending elements of each gap, in blocks of up to
+        // PARALLEL_GRAIN elements
+        GapTask gapSort(*this, mainKeys, mainIds, starts);
+        _pool->parallelFor(gapSort, pairCount + 1, PARALLEL_GRAIN);
+
+        // Step 7: Merge the sorted blocks of larger gaps pairwise, one pass
+        // per doubling of the block size, the merges of a pass in parallel
+        size_t largest = 0;
+        for (size_t g = 0; g <= pairCount; ++g)
+            largest = std::max(largest, size_t(starts[g + 1] - starts[g]));
+        if (largest > PARALLEL_GRAIN)
+        {
+            KeySeq bufferKeys(n, keys[0], _scratch);
+            IdSeq bufferIds(n, 0, _scratch);
+            IdSeq merges(_scratch); // first, middle and last of each merge
+            for (size_t width = PARALLEL_GRAIN; width < largest; width *= 2)
+            {
+                merges.clear();
+                for (size_t g = 0; g <= pairCount; ++g)
+                {
+                    size_t last = g + starts[g + 1];
+                    for (size_t b = g + starts[g]; b + width < last;
+                         b += 2 * width)
+                    {
+                        merges.push_back(static_cast<Id>(b));
+                        merges.push_back(static_cast<Id>(b + width));
+                        merges.push_back(
+                            static_cast<Id>(std::min(last, b + 2 * width)));
+                    }
+                }
+                MergeTask merge(*this, mainKeys, mainIds, bufferKeys,
+                    bufferIds, merges);
+                _pool->parallelFor(merge, merges.size() / 3, 1);
+            }
+        }
+        _printMainChain(mainKeys);
+    }
+
+    // Step 1 of _sortParallel() over a range of pairs
+    template <typename Keys>
+    class PairTask : public ThreadPool::Task
+    {
+    public:
+        PairTask(FordJohnson &engine, Keys const &keys, KeySeq &largerKeys,
+            IdSeq &largerIds, ComparisonBatch &batch)
+            : _engine(engine), _keys(keys), _largerKeys(largerKeys),
+              _largerIds(largerIds), _batch(batch)
+        {
+        }
+
+        void run(size_t begin, size_t end, size_t worker)
+        {
+            _engine._comparePairs(_keys, begin, end, _largerKeys, _largerIds,
+                _batch, &_engine._comp);
+            _engine._workerCounters[worker].add(end - begin);
+        }
+
+    private:
+        FordJohnson &_engine;
+        Keys const &_keys;
+        KeySeq &_largerKeys;
+        IdSeq &_largerIds;
+        ComparisonBatch &_batch;
+    };
+
+    // Step 4 of _sortParallel(): binary search of pending element j among
+    // the larger elements before its partner, mainKeys[0..j)
+    template <typename Keys>
+    class SearchTask : public ThreadPool::Task
+    {
+    public:
+        SearchTask(FordJohnson &engine, Keys const &keys,
+            KeySeq const &mainKeys, IdSeq const &pendingIds, IdSeq &gaps)
+            : _engine(engine), _keys(keys), _mainKeys(mainKeys),
+              _pendingIds(pendingIds), _gaps(gaps)
+        {
+        }
+
+        void run(size_t begin, size_t end, size_t worker)
+        {
+            size_t comparisons = 0;
+            for (size_t j = begin; j < end; ++j)
+            {
+                T const &key = _keys[_pendingIds[j]];
+                size_t left = 0;
+                size_t right = j;
+                while (left < right)
+                {
+                    size_t mid = left + (right - 1 - left) / 2;
+                    ++comparisons;
+                    if (_engine._comp(_mainKeys[mid], key))
+                        left = mid + 1;
+                    else
+                        right = mid;
+                }
+                _gaps[j] = static_cast<Id>(left);
+            }
+            _engine._workerCounters[worker].add(comparisons);
+        }
+
+    private:
+        FordJohnson &_engine;
+        Keys const &_keys;
+        KeySeq const &_mainKeys;
+        IdSeq const &_pendingIds;
+        IdSeq &_gaps;
+    };
+
+    // Step 6 of _sortParallel(): binary insertion sort of the pending
+    // elements of gap g, at mainKeys[g + starts[g]..g + starts[g + 1]), in
+    // blocks of PARALLEL_GRAIN elements so that a gap holding most of them
+    // does not shift elements quadratically
+    class GapTask : public ThreadPool::Task
+    {
+    public:
+        GapTask(FordJohnson &engine, KeySeq &mainKeys, IdSeq &mainIds,
+            IdSeq const &starts)
+            : _engine(engine), _mainKeys(mainKeys), _mainIds(mainIds),
+              _starts(starts)
+        {
+        }
+
+        void run(size_t begin, size_t end, size_t worker)
+        {
+            size_t comparisons = 0;
+            for (size_t g = begin; g < end; ++g)
+            {
+                size_t last = g + _starts[g + 1];
+                for (size_t first = g + _starts[g]; first < last;
+                     first += PARALLEL_GRAIN)
+                    comparisons += _sortBlock(
+                        first, std::min(last, first + PARALLEL_GRAIN));
+            }
+            _engine._workerCounters[worker].add(comparisons);
+        }
+
+    private:
+        FordJohnson &_engine;
+        KeySeq &_mainKeys;
+        IdSeq &_mainIds;
+        IdSeq const &_starts;
+
+        // Sort mainKeys[first..last) and return the comparisons made
+        size_t _sortBlock(size_t first, size_t last)
+        {
+            size_t comparisons = 0;
+            for (size_t i = first + 1; i < last; ++i)
+            {
+                T key = _mainKeys[i];
+                Id id = _mainIds[i];
+                size_t left = first;
+                size_t right = i;
+                while (left < right)
+                {
+                    size_t mid = left + (right - 1 - left) / 2;
+                    ++comparisons;
+                    if (_engine._comp(_mainKeys[mid], key))
+                        left = mid + 1;
+                    else
+                        right = mid;
+                }
+                for (size_t k = i; k > left; --k)
+                {
+                    _mainKeys[k] = _mainKeys[k - 1];
+                    _mainIds[k] = _mainIds[k - 1];
+                }
+                _mainKeys[left] = key;
+                _mainIds[left] = id;
+            }
+            return comparisons;
+        }
+    };
+
+    // Step 7 of _sortParallel(): stable merges of the sorted neighbours
+    // mainKeys[first..middle) and mainKeys[middle..last), through the same
+    // range of the buffers, for each (first, middle, last) of `merges`
+    class MergeTask : public ThreadPool::Task
+    {
+    public:
+        MergeTask(FordJohnson &engine, KeySeq &mainKeys, IdSeq &mainIds,
+            KeySeq &bufferKeys, IdSeq &bufferIds, IdSeq const &merges)
+            : _engine(engine), _mainKeys(mainKeys), _mainIds(mainIds),
+              _bufferKeys(bufferKeys), _bufferIds(bufferIds), _merges(merges)
+        {
+        }
+
+        void run(size_t begin, size_t end, size_t worker)
+        {
+            size_t comparisons = 0;
+            for (size_t m = begin; m < end; ++m)
+            {
+                size_t first = _merges[3 * m];
+                size_t middle = _merges[3 * m + 1];
+                size_t last = _merges[3 * m + 2];
+                size_t left = first;
+                size_t right = middle;
+                for (size_t out = first; out < last; ++out)
+                {
+                    bool takeRight = left == middle;
+                    if (left < middle && right < last)
+                    {
+                        ++comparisons;
+                        takeRight =
+                            _engine._comp(_mainKeys[right], _mainKeys[left]);
+                    }
+                    size_t from = takeRight ? right++ : left++;
+                    _bufferKeys[out] = _mainKeys[from];
+                    _bufferIds[out] = _mainIds[from];
+                }
+                for (size_t k = first; k < last; ++k)
+                {
+                    _mainKeys[k] = _bufferKeys[k];
+                    _mainIds[k] = _bufferIds[k];
+                }
+            }
+            _engine._workerCounters[worker].add(comparisons);
+        }
+
+    private:
+        FordJohnson &_engine;
+        KeySeq &_mainKeys;
+        IdSeq &_mainIds;
+        KeySeq &_bufferKeys;
+        IdSeq &_bufferIds;
+        IdSeq const &_merges;
+    };
+
+    // Room in `batch` for the pairCount comparisons of a level, sized before
+    // the pairs are split among workers: only a BatchComparator uses it
+    void _sizeBatch(ComparisonBatch &batch, size_t pairCount,
+        BatchComparator<T> *)
+    {
+        batch.resize(pairCount);
+    }
+
+    void _sizeBatch(ComparisonBatch &, size_t, void *)
+    {
+    }
+
+    // Compare pairs [begin, end) of `keys`, storing the larger key and id
+    // of pair i at index i; one batch, batch[begin..end), for a
+    // BatchComparator
+    template <typename Keys>
+    void _comparePairs(Keys const &keys, size_t begin, size_t end,
+        KeySeq &largerKeys, IdSeq &largerIds, ComparisonBatch &batch,
+        BatchComparator<T> *)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            batch[i].left = &keys[2 * i + 1];
+            batch[i].right = &keys[2 * i];
+            batch[i].less = false;
+        }
+        _comp(&batch[begin], end - begin);
+        for (size_t i = begin; i < end; ++i)
+        {
+            Id first = static_cast<Id>(2 * i);
+            Id larger = batch[i].less ? first : first + 1;
+            largerKeys[i] = keys[larger];
+            largerIds[i] = larger;
+        }
+    }
+
+    // Contiguous keys and outputs go through PairKernel, when it handles T
+    // and Compare
+    template <typename Keys>
+    void _comparePairs(Keys const &keys, size_t begin, size_t end,
+        KeySeq &largerKeys, IdSeq &largerIds, ComparisonBatch &, void *)
+    {
+        KeySeq const &outKeys = largerKeys;
+        T const *data = _contiguous(keys);
+        if (PairKernel<T, Compare>::value && begin < end && data != NULL &&
+            _contiguous(outKeys) != NULL)
+        {
+            PairKernel<T, Compare>::run(data + 2 * begin, end - begin,
+                static_cast<Id>(2 * begin), &largerKeys[begin],
+                &largerIds[begin]);
+            return;
+        }
+        for (size_t i = begin; i < end; ++i)
+        {
+            Id first = static_cast<Id>(2 * i);
+            Id larger = _comp(keys[first + 1], keys[first]) ? first : first + 1;
+            largerKeys[i] = keys[larger];
+            largerIds[i] = larger;
+        }
+    }
+
+    // Sort `input` into the empty `mainKeys` and `mainIds` (input indices)
+    // if it has at most log2(n) + 1 maximal runs, non-decreasing or strictly
+    // decreasing, found with n - 1 comparisons of neighbours. Descending runs
+    // are reversed, which keeps equal elements in input order as they never
+    // share one, and the runs are then merged pairwise. Returns false, with
+    // both sequences left empty, as soon as the scan finds one run too many.
+    template <typename Input>
+    bool _sortRuns(Input const &input, KeySeq &mainKeys, IdSeq &mainIds)
+    {
+        size_t n = input.size();
+        size_t maxRuns = 1;
+        for (size_t m = n; m > 1; m /= 2)
+            ++maxRuns;
+        // Run r is input[bounds[r]..bounds[r + 1]), reversed if
+        // descending[r] is 1
+        IdSeq bounds(_scratch);
+        IdSeq descending(_scratch);
+        _reserve(bounds, maxRuns + 1);
+        _reserve(descending, maxRuns);
+        bounds.push_back(0);
+        for (size_t start = 0; start < n; start = bounds.back())
+        {
+            if (descending.size() == maxRuns)
+                return false;
+            size_t end = start + 1;
+            bool down = false;
+            if (end < n)
+            {
+                _printCompare(input[end], input[start]);
+                down = _comp(input[end], input[start]);
+                for (++end; end < n; ++end)
+                {
+                    _printCompare(input[end], input[end - 1]);
+                    if (_comp(input[end], input[end - 1]) != down)
+                        break;
+                }
+            }
+            bounds.push_back(static_cast<Id>(end));
+            descending.push_back(down ? 1 : 0);
+        }
+
+        _reserve(mainKeys, n);
+        _reserve(mainIds, n);
+        for (size_t r = 0; r < descending.size(); ++r)
+        {
+            for (size_t k = bounds[r]; k < bounds[r + 1]; ++k)
+            {
+                size_t i = descending[r] ? bounds[r] + bounds[r + 1] - 1 - k
+                                         : k;
+                mainKeys.push_back(input[i]);
+                mainIds.push_back(static_cast<Id>(i));
+            }
+        }
+        _mergeRuns(mainKeys, mainIds, bounds);
+        _printMainChain(mainKeys);
+        return true;
+    }
+
+    // Sort `input` into the empty `mainKeys` and `mainIds` (input indices) by
+    // grouping equal elements: each one is searched among the distinct keys
+    // met so far, in order, and joins the group of the key found equal, or
+    // else is inserted as a new distinct key. The groups are then laid out
+    // in key order, each one in input order. Returns false, with both
+    // sequences left empty, once more than n / DUPLICATE_FACTOR keys are
+    // distinct.
+    template <typename Input>
+    bool _sortDistinct(Input const &input, KeySeq &mainKeys, IdSeq &mainIds)
+    {
+        size_t n = input.size();
+        size_t maxDistinct = std::max(n / DUPLICATE_FACTOR,
+            static_cast<size_t>(1));
+        // Group of each element: the index of the first element equal to it
+        IdSeq groupOf(n, 0, _scratch);
+        // Distinct keys in order, with the index of their first element
+        KeySeq distinctKeys(_scratch);
+        IdSeq distinctIds(_scratch);
+        {
+            Chain chain(distinctKeys, distinctIds, maxDistinct);
+            for (size_t i = 0; i < n; ++i)
+            {
+                size_t pos = _lowerBound(chain, input[i], 0, chain.size());
+                if (pos < chain.size())
+                {
+                    _printCompare(input[i], chain.key(pos));
+                    if (!_comp(input[i], chain.key(pos)))
+                    {
+                        groupOf[i] = chain.id(pos);
+                        continue;
+                    }
+                }
+                if (chain.size() == maxDistinct)
+                    return false;
+                chain.insert(pos, input[i], static_cast<Id>(i));
+                groupOf[i] = static_cast<Id>(i);
+            }
+            chain.commit();
+        }
+        _printMainChain(distinctKeys);
+
+        // Group sizes, then where each group starts, by first element
+        IdSeq next(n, 0, _scratch);
+        for (size_t i = 0; i < n; ++i)
+            ++next[groupOf[i]];
+        size_t start = 0;
+        for (size_t d = 0; d < distinctIds.size(); ++d)
+        {
+            size_t count = next[distinctIds[d]];
+            next[distinctIds[d]] = static_cast<Id>(start);
+            start += count;
+        }
+        mainKeys.assign(n, input[0]);
+        mainIds.assign(n, 0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t pos = next[groupOf[i]]++;
+            mainKeys[pos] = input[i];
+            mainIds[pos] = static_cast<Id>(i);
+        }
+        return true;
+    }
+
+    // Merge neighbouring runs [bounds[r], bounds[r + 1]) of `keys` two by
+    // two, level after level, until a single one is left
+    void _mergeRuns(KeySeq &keys, IdSeq &ids, IdSeq &bounds)
+    {
+        if (bounds.size() <= 2)
+            return;
+        KeySeq otherKeys(keys.size(), keys[0], _scratch);
+        IdSeq otherIds(ids.size(), 0, _scratch);
+        while (bounds.size() > 2)
+        {
+            size_t runs = bounds.size() - 1;
+            size_t merged = 0;
+            for (size_t r = 0; r < runs; r += 2)
+            {
+                size_t last = bounds[std::min(r + 2, runs)];
+                _mergeRunPair(keys, ids, bounds[r], bounds[r + 1], last,
+                    otherKeys, otherIds);
+                bounds[merged++] = bounds[r];
+            }
+            bounds[merged++] = bounds[runs];
+            bounds.resize(merged);
+            keys.swap(otherKeys);
+            ids.swap(otherIds);
+        }
+    }
+
+    // Merge of keys[first..middle) and keys[middle..last) into the same
+    // range of `outKeys`
+    void _mergeRunPair(KeySeq const &keys, IdSeq const &ids, size_t first,
+        size_t middle, size_t last, KeySeq &outKeys, IdSeq &outIds)
+    {
+        RunPairMerge merge(keys, ids, first, middle, outKeys, outIds);
+        _binaryMerge(merge, middle - first, last - middle);
+    }
+
+    // Stable merge of the `left` elements of the left run of `merge` with
+    // the `right` ones of its right run, by Hwang and Lin's binary merge
+    // (Knuth, TAOCP 5.3.2, Algorithm H): with m elements left in the
+    // shorter run and m * 2^t <= n < m * 2^(t + 1) in the longer one, the
+    // largest of the shorter run is compared with the 2^t-th largest of the
+    // longer; either those 2^t elements all go last, or it is inserted
+    // among them with t more comparisons. Equal-sized runs merge in
+    // m + n - 1 comparisons, a short one in about m (t + 1). The output is
+    // filled from the back.
+    template <typename Merge>
+    void _binaryMerge(Merge &merge, size_t left, size_t right)
+    {
+        size_t out = left + right; // merged elements start there
+        while (left > 0 && right > 0)
+        {
+            bool shortIsLeft = left <= right;
+            size_t &shortCount = shortIsLeft ? left : right;
+            size_t &longCount = shortIsLeft ? right : left;
+            size_t block = 1;
+            while (2 * block * shortCount <= longCount)
+                block *= 2;
+
+            T const &key = merge.key(shortIsLeft, shortCount - 1);
+            size_t probe = longCount - block;
+            size_t from = probe;
+            if (_goesAfter(key, shortIsLeft, merge.key(!shortIsLeft, probe)))
+            {
+                from = probe + 1;
+                size_t to = longCount;
+                while (from < to)
+                {
+                    size_t mid = from + (to - 1 - from) / 2;
+                    if (_goesAfter(
+                            key, shortIsLeft, merge.key(!shortIsLeft, mid)))
+                        from = mid + 1;
+                    else
+                        to = mid;
+                }
+            }
+            merge.move(!shortIsLeft, from, longCount, out);
+            out -= longCount - from;
+            longCount = from;
+            if (from > probe)
+            {
+                merge.move(shortIsLeft, shortCount - 1, shortCount, out);
+                --out;
+                --shortCount;
+            }
+        }
+        merge.move(true, 0, left, out);
+        merge.move(false, 0, right, out);
+    }
+
+    // Runs and output of _binaryMerge(): key(left, i) is element i of the
+    // left or right run, and move(left, begin, end, out) copies elements
+    // [begin, end) of a run to just before output position `out`.
+    //
+    // _mergeRunPair(): two neighbouring runs of `keys`, with their ids, into
+    // the same range of `outKeys` and `outIds`
+    class RunPairMerge
+    {
+    public:
+        RunPairMerge(KeySeq const &keys, IdSeq const &ids, size_t first,
+            size_t middle, KeySeq &outKeys, IdSeq &outIds)
+            : _keys(keys), _ids(ids), _first(first), _middle(middle),
+              _outKeys(outKeys), _outIds(outIds)
+        {
+        }
+
+        T const &key(bool left, size_t i) const
+        {
+            return _keys[(left ? _first : _middle) + i];
+        }
+
+        void move(bool left, size_t begin, size_t end, size_t out)
+        {
+            size_t start = left ? _first : _middle;
+            for (size_t i = end; i > begin; --i)
+            {
+                --out;
+                _outKeys[_first + out] = _keys[start + i - 1];
+                _outIds[_first + out] = _ids[start + i - 1];
+            }
+        }
+
+    private:
+        KeySeq const &_keys;
+        IdSeq const &_ids;
+        size_t _first;
+        size_t _middle;
+        KeySeq &_outKeys;
+        IdSeq &_outIds;
+    };
+
+    // insert(): the sorted elements[0..n) and `batch`, in place into
+    // `elements`, already resized to hold both. Output positions of the
+    // left run are never below its own, so it is copied backwards safely,
+    // and not at all once in place.
+    class InsertMerge
+    {
+    public:
+        InsertMerge(Container &elements, Container const &batch)
+            : _elements(elements), _batch(batch)
+        {
+        }
+
+        T const &key(bool left, size_t i) const
+        {
+            return left ? _elements[i] : _batch[i];
+        }
+
+        void move(bool left, size_t begin, size_t end, size_t out)
+        {
+            if (left && out == end)
+                return;
+            for (size_t i = end; i > begin; --i)
+            {
+                --out;
+                _elements[out] = left ? _elements[i - 1] : _batch[i - 1];
+            }
+        }
+
+    private:
+        Container &_elements;
+        Container const &_batch;
+    };
+
+    // Whether `key`, of the left run if keyIsLeft and of the right one
+    // otherwise, goes after `other` of the other run: between equal keys,
+    // the left one goes first
+    bool _goesAfter(T const &key, bool keyIsLeft, T const &other)
+    {
+        if (keyIsLeft)
+        {
+            _printCompare(other, key);
+            return _comp(other, key);
+        }
+        _printCompare(key, other);
+        return !_comp(key, other);
+    }
+
+    void _insertWithJacobsthalOrder(KeySeq &mainKeys, IdSeq &mainIds,
+        KeySeq const &pendingKeys, IdSeq const &pendingIds)
+    {
+        // Gap of every element by id, and pending counts per gap
+        size_t largerCount = mainKeys.size();
+        size_t pendingCount = pendingKeys.size();
+        IdSeq gapOf(largerCount + pendingCount, NO_ID, _scratch);
+        IdSeq insertedPerGap(largerCount + 2, 0, _scratch);
+        for (size_t k = 0; k < largerCount; ++k)
+            gapOf[mainIds[k]] = static_cast<Id>(k);
+
+        // pending[0] is inserted first (unconditionally at the front)
+        mainKeys.insert(mainKeys.begin(), pendingKeys[0]);
+        mainIds.insert(mainIds.begin(), pendingIds[0]);
+        gapOf[pendingIds[0]] = 0;
+        _fenwickAdd(insertedPerGap, 0);
+        _printMainChain(mainKeys);
+        if (pendingCount <= 1)
+            return;
+
+        IdSeq endpoints = _generateJacobsthalSequence(pendingCount);
+
+        Chain chain(mainKeys, mainIds, pendingCount - 1);
+        // Insert elements according to Ford-Johnson group endpoints, the
+        // last group cut at pendingCount
+        for (size_t i = 3; i < endpoints.size(); ++i)
+        {
+            size_t groupStart = endpoints[i] - 1;
+            size_t groupEnd = endpoints[i - 1];
+            // Insert elements in reverse order within each group
+            for (size_t j = groupStart; j >= groupEnd; --j)
+            {
+                // Search bound: where its larger partner is now (the odd
+                // element, with the last id, has no partner)
+                Id id = pendingIds[j];
+                size_t maxPos = chain.size();
+                if (id < 2 * largerCount)
+                {
+                    size_t partnerGap = gapOf[id ^ 1];
+                    maxPos = partnerGap +
+                             _fenwickPrefix(insertedPerGap, partnerGap);
+                }
+                size_t pos = _binaryInsert(chain, pendingKeys[j], id, maxPos);
+                // It shares the gap of the element it was inserted before
+                size_t gap = pos + 1 < chain.size() ? gapOf[chain.id(pos + 1)]
+                                                    : largerCount;
+                gapOf[id] = static_cast<Id>(gap);
+                _fenwickAdd(insertedPerGap, gap);
+                _printMainChain(chain);
+            }
+        }
+        chain.commit();
+    }
+
+    // Insert `key` at its place among chain[0..maxPos) and return the
+    // position it was inserted at
+    size_t _binaryInsert(Chain &chain, T const &key, Id id, size_t maxPos)
+    {
+        size_t pos = _lowerBound(chain, key, 0, maxPos);
+        chain.insert(pos, key, id);
+        return pos;
+    }
+
+    // Position of the first of chain[first..last) not less than `key` (or
+    // the end of that range). The outcome of a probe only feeds masks, not
+    // branches, and the two possible next probes are prefetched meanwhile.
+    // Probes are those of the textbook search, the lower middle of the
+    // range, so the comparisons match Ford-Johnson's count exactly; on the
+    // 2^k - 1 elements of a typical insertion, both halves are equal and
+    // the loop runs k times whatever the outcomes.
+    size_t _lowerBound(
+        Chain const &chain, T const &key, size_t first, size_t last)
+    {
+        size_t end = std::min(last, chain.size());
+        size_t left = first;
+        size_t count = end > first ? end - first : 0;
+        typename Chain::Search search(chain);
+        while (count > 0)
+        {
+            // The range continues as [left, left + half) or as
+            // [left + half + 1, left + count); the middle of an empty one
+            // is past the chain, which prefetch() ignores
+            size_t half = (count - 1) / 2;
+            search.prefetch(left + (half - 1) / 2);
+            search.prefetch(left + half + 1 + (count - half - 2) / 2);
+            T const &probe = search.probe(left + half);
+            _printCompare(probe, key);
+            bool goRight = _comp(probe, key);
+            size_t mask = 0 - static_cast<size_t>(goRight);
+            left += (half + 1) & mask;
+            count = half + ((count - 1 - 2 * half) & mask);
+        }
+        return left;
+    }
+
+    // Ford-Johnson group endpoints: 0, 1, 1, 3, 5, 11, 21, ... (Jacobsthal
+    // numbers) up to the first one reaching n, replaced by n
+    IdSeq _generateJacobsthalSequence(size_t n) const
+    {
+        IdSeq sequence(_scratch);
+        // J(k) ~ 2^k / 3: at most one number per bit of n, plus 0, 1, 1, n
+        _reserve(sequence, CHAR_BIT * sizeof(Id) + 4);
+        sequence.push_back(0);
+        sequence.push_back(1);
+        for (size_t i = 2;; ++i)
+        {
+            size_t next = sequence[i - 1] +
+                          2 * static_cast<size_t>(sequence[i - 2]);
+            sequence.push_back(static_cast<Id>(std::min(next, n)));
+            if (next >= n)
+                break;
+        }
+        return sequence;
+    }
+
+    // First key of `keys` if they are stored contiguously, else NULL
+    template <typename A>
+    static T const *_contiguous(std::vector<T, A> const &keys)
+    {
+        return keys.empty() ? NULL : &keys[0];
+    }
+
+    static T const *_contiguous(Range<T *> const &keys)
+    {
+        return keys.begin();
+    }
+
+    static T const *_contiguous(Range<T const *> const &keys)
+    {
+        return keys.begin();
+    }
+
+    static T const *_contiguous(
+        Range<typename std::vector<T>::iterator> const &keys)
+    {
+        return keys.empty() ? NULL : &*keys.begin();
+    }
+
+    static T const *_contiguous(
+        Range<typename std::vector<T>::const_iterator> const &keys)
+    {
+        return keys.empty() ? NULL : &*keys.begin();
+    }
+
+    template <typename Any>
+    static T const *_contiguous(Any const &)
+    {
+        return NULL;
+    }
+
+    // Capacity hint, for the sequences that support one
+    template <typename U, typename A>
+    static void _reserve(std::vector<U, A> &sequence, size_t n)
+    {
+        sequence.reserve(n);
+    }
+
+    template <typename Any>
+    static void _reserve(Any &, size_t)
+    {
+    }
+
+    static void _fenwickAdd(IdSeq &tree, size_t gap)
+    {
+        for (size_t i = gap + 1; i < tree.size(); i += i & (~i + 1))
+            ++tree[i];
+    }
+
+    static size_t _fenwickPrefix(IdSeq const &tree, size_t gap)
+    {
+        size_t sum = 0;
+        for (size_t i = gap + 1; i > 0; i -= i & (~i + 1))
+            sum += tree[i];
+        return sum;
+    }
+
+    // Counts a comparison of the sequential levels, and prints it when
+    // debugging
+    void _printCompare(T const &a, T const &b)
+    {
+        _counter.add(1);
+#ifdef DEBUG
+        std::cout << _label << "Compare: (" << a << ", " << b << ")\n";
+#else
+        (void)a;
+        (void)b;
+#endif
+    }
+
+    void _printMainChain(KeySeq const &keys) const
+    {
+#ifdef DEBUG
+        _printKeys("MainChain: ", keys);
+#else
+        (void)keys;
+#endif
+    }
+
+    void _printMainChain(Chain const &chain) const
+    {
+#ifdef DEBUG
+        std::cout << _label << "MainChain: ";
+        for (size_t i = 0; i < chain.size(); ++i)
+            std::cout << chain.key(i) << " ";
+        std::cout << std::endl;
+#else
+        (void)chain;
+#endif
+    }
+
+    void _printPending(KeySeq const &keys) const
+    {
+#ifdef DEBUG
+        _printKeys("Pending: ", keys);
+#else
+        (void)keys;
+#endif
+    }
+
+    void _printKeys(std::string const &name, KeySeq const &keys) const
+    {
+        std::cout << _label << name;
+        for (size_t i = 0; i < keys.size(); ++i)
+            std::cout << keys[i] << " ";
+        std::cout << std::endl;
+    }
+};
+
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare, typename Alloc, typename Counter>
+const typename FordJohnson<Sequence, T, Compare, Alloc, Counter>::Id
+    FordJohnson<Sequence, T, Compare, Alloc, Counter>::NO_ID;
+
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare, typename Alloc, typename Counter>
+const size_t
+    FordJohnson<Sequence, T, Compare, Alloc, Counter>::MAX_ELEMENTS;
+
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare, typename Alloc, typename Counter>
+const size_t
+    FordJohnson<Sequence, T, Compare, Alloc, Counter>::SCRATCH_PER_ELEMENT;
+
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare, typename Alloc, typename Counter>
+const size_t
+    FordJohnson<Sequence, T, Compare, Alloc, Counter>::PARALLEL_MIN_ELEMENTS;
+
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare, typename Alloc, typename Counter>
+const size_t
+    FordJohnson<Sequence, T, Compare, Alloc, Counter>::PARALLEL_GRAIN;
+
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare, typename Alloc, typename Counter>
+const size_t
+    FordJohnson<Sequence, T, Compare, Alloc, Counter>::DUPLICATE_FACTOR;
+
+#endif /* FORDJOHNSON_HPP */
@@ -0,0 +1,13 @@
+#include "HybridSort.hpp"
+
+char const *sortAlgorithmName(SortAlgorithm algorithm) {
+    switch (algorithm) {
+        case FORD_JOHNSON:
+            return "Ford-Johnson";
+        case SORTING_NETWORK:
+            return "sorting network";
+        case RADIX_SORT:
+            return "radix sort";
+    }
+    return "unknown";
+}
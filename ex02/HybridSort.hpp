@@ -0,0 +1,338 @@
+#ifndef HYBRIDSORT_HPP
+#define HYBRIDSORT_HPP
+#include <climits>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FordJohnson.hpp"
+
+enum SortAlgorithm
+{
+    FORD_JOHNSON,
+    SORTING_NETWORK,
+    RADIX_SORT
+};
+
+char const *sortAlgorithmName(SortAlgorithm algorithm);
+
+// Estimated cost of a comparison, relative to moving elements around
+enum ComparisonCost
+{
+    CHEAP_COMPARISONS,
+    EXPENSIVE_COMPARISONS
+};
+
+// Integer types radix sort handles, with the unsigned type of their bits
+template <typename T>
+struct IntegerKey
+{
+    static const bool value = false;
+};
+
+#define INTEGER_KEY(Type, UnsignedType, IsSigned)                             \
+    template <>                                                               \
+    struct IntegerKey<Type>                                                   \
+    {                                                                         \
+        static const bool value = true;                                       \
+        static const bool isSigned = IsSigned;                                \
+        typedef UnsignedType Unsigned;                                        \
+    }
+
+INTEGER_KEY(signed char, unsigned char, true);
+INTEGER_KEY(unsigned char, unsigned char, false);
+INTEGER_KEY(short, unsigned short, true);
+INTEGER_KEY(unsigned short, unsigned short, false);
+INTEGER_KEY(int, unsigned int, true);
+INTEGER_KEY(unsigned int, unsigned int, false);
+INTEGER_KEY(long, unsigned long, true);
+INTEGER_KEY(unsigned long, unsigned long, false);
+
+#undef INTEGER_KEY
+
+// Order of Compare on T as seen by radix sort: 1 ascending, -1 descending,
+// 0 when T is not an integer key or Compare is not std::less / std::greater
+template <typename T, typename Compare>
+struct RadixOrder
+{
+    static const int value = 0;
+};
+
+template <typename T>
+struct RadixOrder<T, std::less<T> >
+{
+    static const int value = IntegerKey<T>::value ? 1 : 0;
+};
+
+template <typename T>
+struct RadixOrder<T, std::greater<T> >
+{
+    static const int value = IntegerKey<T>::value ? -1 : 0;
+};
+
+// Default cost estimate of Compare: the standard orders of arithmetic types
+// are cheap, anything else (strings, user comparators) is assumed expensive
+template <typename T, typename Compare>
+struct DefaultComparisonCost
+{
+    static const ComparisonCost value = EXPENSIVE_COMPARISONS;
+};
+
+template <typename T>
+struct CheapToCompare
+{
+    static const bool value = IntegerKey<T>::value;
+};
+
+template <>
+struct CheapToCompare<float>
+{
+    static const bool value = true;
+};
+
+template <>
+struct CheapToCompare<double>
+{
+    static const bool value = true;
+};
+
+template <typename T>
+struct DefaultComparisonCost<T, std::less<T> >
+{
+    static const ComparisonCost value = CheapToCompare<T>::value
+                                            ? CHEAP_COMPARISONS
+                                            : EXPENSIVE_COMPARISONS;
+};
+
+template <typename T>
+struct DefaultComparisonCost<T, std::greater<T> >
+{
+    static const ComparisonCost value = CheapToCompare<T>::value
+                                            ? CHEAP_COMPARISONS
+                                            : EXPENSIVE_COMPARISONS;
+};
+
+// Sort that picks its algorithm from the element type, the comparison cost
+// and n. Ford-Johnson makes the fewest comparisons but moves elements a lot,
+// which only pays off when comparisons are expensive; with cheap ones, small
+// inputs go through a sorting network and integer keys through radix sort,
+// and only what remains uses Ford-Johnson.
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare = std::less<T>, typename Alloc = std::allocator<T> >
+class HybridSort
+{
+public:
+    typedef Sequence<T, Alloc> Container;
+
+    HybridSort()
+        : _comp(), _cost(DefaultComparisonCost<T, Compare>::value),
+          _fordJohnson(), _last(FORD_JOHNSON), _comparisons(0)
+    {
+    }
+
+    explicit HybridSort(
+        std::string const &label, Compare const &comp = Compare())
+        : _comp(comp), _cost(DefaultComparisonCost<T, Compare>::value),
+          _fordJohnson(label, comp), _last(FORD_JOHNSON), _comparisons(0)
+    {
+    }
+
+    ~HybridSort()
+    {
+    }
+
+    HybridSort(HybridSort const &other)
+        : _comp(other._comp), _cost(other._cost),
+          _fordJohnson(other._fordJohnson), _last(other._last),
+          _comparisons(other._comparisons)
+    {
+    }
+
+    HybridSort &operator=(HybridSort const &other)
+    {
+        if (this != &other)
+        {
+            _comp = other._comp;
+            _cost = other._cost;
+            _fordJohnson = other._fordJohnson;
+            _last = other._last;
+            _comparisons = other._comparisons;
+        }
+        return *this;
+    }
+
+    // Override the cost estimate derived from T and Compare
+    void setComparisonCost(ComparisonCost cost)
+    {
+        _cost = cost;
+    }
+
+    ComparisonCost comparisonCost() const
+    {
+        return _cost;
+    }
+
+    // Threads of the Ford-Johnson engine
+    void setThreads(size_t threads)
+    {
+        _fordJohnson.setThreads(threads);
+    }
+
+    // Algorithm sort() uses for n elements
+    SortAlgorithm choose(size_t n) const
+    {
+        if (_cost == EXPENSIVE_COMPARISONS)
+            return FORD_JOHNSON;
+        if (n <= NETWORK_MAX_ELEMENTS)
+            return SORTING_NETWORK;
+        if (RadixOrder<T, Compare>::value != 0)
+            return RADIX_SORT;
+        return FORD_JOHNSON;
+    }
+
+    // Sorted copy of `input`
+    Container sort(Container const &input)
+    {
+        _last = choose(input.size());
+        _comparisons = 0;
+        if (_last == SORTING_NETWORK)
+            return _networkSort(input);
+        if (_last == RADIX_SORT)
+            return _radixSort(input, Tag<RadixOrder<T, Compare>::value != 0>());
+        Container result = _fordJohnson.sort(input);
+        _comparisons = _fordJohnson.comparisons();
+        return result;
+    }
+
+    // Algorithm and comparisons of the last sort() call (radix sort makes
+    // none)
+    SortAlgorithm lastAlgorithm() const
+    {
+        return _last;
+    }
+
+    size_t comparisons() const
+    {
+        return _comparisons;
+    }
+
+private:
+    // Largest input sorted by the network. Its O(n log^2 n) comparisons have
+    // no data-dependent branches: on ints it beats radix sort up to about
+    // 100 elements, and Ford-Johnson well beyond that.
+    static const size_t NETWORK_MAX_ELEMENTS = 64;
+    static const size_t RADIX_BITS = 8;
+
+    // Compile-time choice between overloads
+    template <bool Value>
+    struct Tag
+    {
+    };
+
+    Compare _comp;
+    ComparisonCost _cost;
+    FordJohnson<Sequence, T, Compare, Alloc> _fordJohnson;
+    SortAlgorithm _last;
+    size_t _comparisons;
+
+    // Batcher's merge exchange (Knuth, TAOCP 5.2.2, Algorithm M), which
+    // works for any n
+    Container _networkSort(Container const &input)
+    {
+        Container elements(input);
+        size_t n = elements.size();
+        size_t t = 0;
+        while ((static_cast<size_t>(1) << t) < n)
+            ++t;
+        for (size_t p = t > 0 ? static_cast<size_t>(1) << (t - 1) : 0; p > 0;
+             p /= 2)
+        {
+            size_t q = static_cast<size_t>(1) << (t - 1);
+            size_t r = 0;
+            size_t d = p;
+            for (;;)
+            {
+                for (size_t i = 0; i + d < n; ++i)
+                {
+                    if ((i & p) == r)
+                        _compareExchange(elements[i], elements[i + d]);
+                }
+                if (q == p)
+                    break;
+                d = q - p;
+                q /= 2;
+                r = p;
+            }
+        }
+        return elements;
+    }
+
+    void _compareExchange(T &a, T &b)
+    {
+        ++_comparisons;
+        if (_comp(b, a))
+            std::swap(a, b);
+    }
+
+    // LSD radix sort on RADIX_BITS digits of the key bits, the sign bit
+    // flipped for signed types and every bit for descending order. Digits
+    // equal in every key are skipped.
+    Container _radixSort(Container const &input, Tag<true>)
+    {
+        typedef typename IntegerKey<T>::Unsigned Key;
+        std::vector<T> elements(input.begin(), input.end());
+        std::vector<T> buffer(elements.size());
+        std::vector<size_t> counts(1 << RADIX_BITS);
+        for (size_t shift = 0; shift < CHAR_BIT * sizeof(Key);
+             shift += RADIX_BITS)
+        {
+            counts.assign(counts.size(), 0);
+            for (size_t i = 0; i < elements.size(); ++i)
+                ++counts[_digit<Key>(elements[i], shift)];
+            if (counts[_digit<Key>(elements[0], shift)] == elements.size())
+                continue;
+            size_t start = 0;
+            for (size_t d = 0; d < counts.size(); ++d)
+            {
+                size_t count = counts[d];
+                counts[d] = start;
+                start += count;
+            }
+            for (size_t i = 0; i < elements.size(); ++i)
+                buffer[counts[_digit<Key>(elements[i], shift)]++] = elements[i];
+            elements.swap(buffer);
+        }
+        return Container(
+            elements.begin(), elements.end(), input.get_allocator());
+    }
+
+    // Never chosen: T is not an integer key
+    Container _radixSort(Container const &input, Tag<false>)
+    {
+        return _fordJohnson.sort(input);
+    }
+
+    template <typename Key>
+    static size_t _digit(T value, size_t shift)
+    {
+        Key key = static_cast<Key>(value);
+        if (IntegerKey<T>::isSigned)
+            key ^= static_cast<Key>(static_cast<Key>(1)
+                                    << (CHAR_BIT * sizeof(Key) - 1));
+        if (RadixOrder<T, Compare>::value < 0)
+            key = static_cast<Key>(~key);
+        return (key >> shift) & ((1 << RADIX_BITS) - 1);
+    }
+};
+
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare, typename Alloc>
+const size_t HybridSort<Sequence, T, Compare, Alloc>::NETWORK_MAX_ELEMENTS;
+
+template <template <typename, typename> class Sequence, typename T,
+    typename Compare, typename Alloc>
+const size_t HybridSort<Sequence, T, Compare, Alloc>::RADIX_BITS;
+
+#endif /* HYBRIDSORT_HPP */
@@ -0,0 +1,78 @@
+#ifndef PAIRKERNEL_HPP
+#define PAIRKERNEL_HPP
+#include <stdint.h>
+
+#include <cstddef>
+#include <functional>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Step 1 of FordJohnson on contiguous keys: for pair i of keys[0..2 count),
+// write its larger key to largerKeys[i] and the index of that key to
+// largerIds[i], firstId + 2i + 1 unless the second key orders before the
+// first. The default leaves pairing to the comparator, one call per pair;
+// specialize, with value true, for orders that can pair without calling
+// Compare.
+template <typename T, typename Compare>
+struct PairKernel
+{
+    static const bool value = false;
+
+    static void run(T const *, size_t, uint32_t, T *, uint32_t *)
+    {
+    }
+};
+
+// int in ascending order: the larger key is a lane-wise max, and its index
+// the odd one plus the all-ones mask of the lanes where the even key is
+// greater. With SSE2, four pairs at a time: the even and odd keys of two
+// loads are split into two vectors by shuffles.
+template <>
+struct PairKernel<int, std::less<int> >
+{
+    static const bool value = true;
+
+    static void run(int const *keys, size_t count, uint32_t firstId,
+        int *largerKeys, uint32_t *largerIds)
+    {
+        size_t i = 0;
+#if defined(__SSE2__)
+        __m128i ids = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(firstId)),
+            _mm_setr_epi32(1, 3, 5, 7));
+        __m128i step = _mm_set1_epi32(8);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i low = _mm_loadu_si128(
+                reinterpret_cast<__m128i const *>(keys + 2 * i));
+            __m128i high = _mm_loadu_si128(
+                reinterpret_cast<__m128i const *>(keys + 2 * i + 4));
+            // e0 e1 o0 o1 and e2 e3 o2 o3
+            low = _mm_shuffle_epi32(low, _MM_SHUFFLE(3, 1, 2, 0));
+            high = _mm_shuffle_epi32(high, _MM_SHUFFLE(3, 1, 2, 0));
+            __m128i even = _mm_unpacklo_epi64(low, high);
+            __m128i odd = _mm_unpackhi_epi64(low, high);
+            __m128i evenLarger = _mm_cmpgt_epi32(even, odd);
+            __m128i larger = _mm_or_si128(_mm_and_si128(evenLarger, even),
+                _mm_andnot_si128(evenLarger, odd));
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(largerKeys + i), larger);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(largerIds + i),
+                _mm_add_epi32(ids, evenLarger));
+            ids = _mm_add_epi32(ids, step);
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            int first = keys[2 * i];
+            int second = keys[2 * i + 1];
+            uint32_t evenLarger = second < first;
+            largerKeys[i] = evenLarger ? first : second;
+            largerIds[i] = static_cast<uint32_t>(firstId + 2 * i + 1) -
+                           evenLarger;
+        }
+    }
+};
+
+#endif /* PAIRKERNEL_HPP */
@@ -1,11 +1,11 @@
 #ifndef PMERGEME_HPP
 #define PMERGEME_HPP
 #include <deque>
-#include <iostream>
-#include <iterator>
-#include <utility>
 #include <vector>
 
+#include "FordJohnson.hpp"
+#include "HybridSort.hpp"
+
 class PmergeMe
 {
 public:
@@ -15,70 +15,132 @@ public:
     PmergeMe(PmergeMe const &other);
     PmergeMe &operator=(PmergeMe const &other);
 
+    // Ford-Johnson, within F(n) comparisons unless run detection is on
     std::vector<int> mergeInsertSortByVector();
     std::deque<int> mergeInsertSortByDeque();
 
+    // The same on a caller-owned range, sorted in place or written to
+    // `out`: only the scratch of the requested backend is allocated, and
+    // nothing is copied into the PmergeMe
+    template <typename RandomAccessIterator>
+    void mergeInsertSortByVector(
+        RandomAccessIterator first, RandomAccessIterator last)
+    {
+        mergeInsertSortByVector(first, last, first);
+    }
+
+    template <typename RandomAccessIterator, typename OutputIterator>
+    OutputIterator mergeInsertSortByVector(RandomAccessIterator first,
+        RandomAccessIterator last, OutputIterator out)
+    {
+        FordJohnson<std::vector, int> engine("Vector ");
+        _configure(engine);
+        out = engine.sort(first, last, out);
+        _vectorComparisons = engine.comparisons();
+        return out;
+    }
+
+    template <typename RandomAccessIterator>
+    void mergeInsertSortByDeque(
+        RandomAccessIterator first, RandomAccessIterator last)
+    {
+        mergeInsertSortByDeque(first, last, first);
+    }
+
+    template <typename RandomAccessIterator, typename OutputIterator>
+    OutputIterator mergeInsertSortByDeque(RandomAccessIterator first,
+        RandomAccessIterator last, OutputIterator out)
+    {
+        FordJohnson<std::deque, int> engine("Deque ");
+        _configure(engine);
+        out = engine.sort(first, last, out);
+        _dequeComparisons = engine.comparisons();
+        return out;
+    }
+
+    // Live sorted index of every element: the input given at construction
+    // (sorted on first use) and the batches inserted since. insert() merges
+    // a batch in with comparisons proportional to its size rather than to
+    // the whole sequence (see FordJohnson::insert()); the batch also joins
+    // the input of the container sorts.
+    void insert(std::vector<int> const &batch);
+    std::vector<int> const &sorted();
+
+    // Smallest k elements, sorted, with far fewer comparisons than a full
+    // sort when k is small (see FordJohnson::partialSort())
+    std::vector<int> partialSortByVector(size_t k);
+    // Whichever of Ford-Johnson, a sorting network or radix sort suits the
+    // input best (see HybridSort)
+    std::vector<int> autoSort();
+
+    // Sorted copy of any elements ordered by `comp`, which may be a
+    // BatchComparator. T must be printable in DEBUG builds.
+    template <typename T, typename Compare>
+    std::vector<T> mergeInsertSort(
+        std::vector<T> const &elements, Compare const &comp) const
+    {
+        FordJohnson<std::vector, T, Compare> engine("Generic ", comp);
+        _configure(engine);
+        return engine.sort(elements);
+    }
+
+    // Smallest k of any elements ordered by `comp`, sorted
+    template <typename T, typename Compare>
+    std::vector<T> mergeInsertPartialSort(std::vector<T> const &elements,
+        size_t k, Compare const &comp) const
+    {
+        FordJohnson<std::vector, T, Compare> engine("Generic ", comp);
+        _configure(engine);
+        return engine.partialSort(elements, k);
+    }
+
+    // Sorting permutation of `elements` (see FordJohnson::argsort()), with
+    // which applyPermutation() reorders records sharing their indices
+    template <typename T, typename Compare>
+    std::vector<size_t> mergeInsertArgsort(std::vector<T> const &elements,
+        Compare const &comp, bool stable = false) const
+    {
+        FordJohnson<std::vector, T, Compare> engine("Generic ", comp);
+        _configure(engine);
+        return engine.argsort(elements, stable);
+    }
+
+    // Threads used by the sorts (1, the default: sequential)
+    void setThreads(size_t threads);
+    // Scan for sorted runs first: presorted input then costs n - 1
+    // comparisons, any other up to n - 1 more than F(n) (off by default)
+    void setRunDetection(bool enabled);
+    // Group equal elements first, for inputs where values repeat a lot
+    // (off by default)
+    void setDuplicateCollapsing(bool enabled);
+
+    // Comparisons made by the last sort of each container (or insert(), for
+    // the vector)
+    size_t vectorComparisons() const;
+    size_t dequeComparisons() const;
+    // Algorithm picked by the last autoSort()
+    SortAlgorithm autoAlgorithm() const;
+
 private:
+    // Input of the container sorts, which the deque backend reads in place
     std::vector<int> _unsortedVec;
-    std::deque<int> _unsortedDeq;
-
-    typedef std::pair<int, size_t> IndexedInt;
-
-    // Vector implementations
-    std::vector<IndexedInt> _mergeInsertSortVector(
-        std::vector<IndexedInt> &indexedVec);
-    void _insertWithJacobsthalOrder(std::vector<IndexedInt> &mainChain,
-                                    std::vector<std::pair<IndexedInt, size_t> > const &pending);
-    void _binaryInsertOptimized(
-        std::vector<IndexedInt> &vec, const IndexedInt &value, int maxPos);
-    std::vector<size_t> _generateJacobsthalSequence(size_t n);
-
-    // Deque implementations
-    std::deque<IndexedInt> _mergeInsertSortDeque(
-        std::deque<IndexedInt> &indexedDeq);
-    void _insertWithJacobsthalOrder(std::deque<IndexedInt> &mainChain,
-                                    std::deque<std::pair<IndexedInt, size_t> > const &pending);
-    void _binaryInsertOptimized(
-        std::deque<IndexedInt> &deq, const IndexedInt &value, int maxPos);
-    std::deque<size_t> _generateJacobsthalSequenceDeque(size_t n);
-
-    // For debugging
-    int _countVectorCompare();
-    int _countDequeCompare();
-    void _printCompare(int a, int b, const std::string &type);
-    template <typename IndexedIntContainer>
-    void _printMainChain(
-        const IndexedIntContainer &container, const std::string &type)
-    {
-#ifdef DEBUG
-        std::cout << type << "MainChain: ";
-        for (size_t i = 0; i < container.size(); ++i)
-        {
-            std::cout << container[i].first << " ";
-        }
-        std::cout << std::endl;
-#else
-        (void)container;
-        (void)type;
-#endif
-    };
-
-    template <typename PendingContainer>
-    void _printPending(
-        const PendingContainer &pending, const std::string &type)
+    std::vector<int> _sorted;
+    bool _isSorted; // whether _sorted holds all of _unsortedVec
+    size_t _threads;
+    bool _runDetection;
+    bool _duplicateCollapsing;
+    size_t _vectorComparisons;
+    size_t _dequeComparisons;
+    SortAlgorithm _autoAlgorithm;
+
+    // Settings shared by every Ford-Johnson engine
+    template <typename Engine>
+    void _configure(Engine &engine) const
     {
-#ifdef DEBUG
-        std::cout << type << "Pending: ";
-        for (size_t i = 0; i < pending.size(); ++i)
-        {
-            std::cout << pending[i].first.first << " ";
-        }
-        std::cout << std::endl;
-#else
-        (void)pending;
-        (void)type;
-#endif
-    };
+        engine.setThreads(_threads);
+        engine.setRunDetection(_runDetection);
+        engine.setDuplicateCollapsing(_duplicateCollapsing);
+    }
 };
 
 #endif /* PMERGEME_HPP */
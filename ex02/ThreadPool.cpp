@@ -0,0 +1,157 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::Task::~Task() {}
+
+ThreadPool::ThreadPool(size_t threads)
+    : _threads(), _workers(), _queues(), _remaining(0), _generation(0),
+      _stopping(false) {
+    if (threads == 0)
+        threads = 1;
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_wake, NULL);
+    pthread_cond_init(&_done, NULL);
+    // Workers are referenced by the threads: no reallocation after start
+    _workers.reserve(threads);
+    _queues.reserve(threads);
+    _threads.reserve(threads - 1);
+    for (size_t i = 0; i < threads; ++i) {
+        Worker worker = {this, i};
+        Queue *queue = new Queue();
+        pthread_mutex_init(&queue->lock, NULL);
+        _workers.push_back(worker);
+        _queues.push_back(queue);
+        if (i == 0)
+            continue;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, _main, &_workers.back()) != 0) {
+            pthread_mutex_destroy(&queue->lock);
+            delete queue;
+            _queues.pop_back();
+            _workers.pop_back();
+            break;
+        }
+        _threads.push_back(thread);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    pthread_mutex_lock(&_lock);
+    _stopping = true;
+    pthread_cond_broadcast(&_wake);
+    pthread_mutex_unlock(&_lock);
+    for (size_t i = 0; i < _threads.size(); ++i)
+        pthread_join(_threads[i], NULL);
+    for (size_t i = 0; i < _queues.size(); ++i) {
+        pthread_mutex_destroy(&_queues[i]->lock);
+        delete _queues[i];
+    }
+    pthread_cond_destroy(&_done);
+    pthread_cond_destroy(&_wake);
+    pthread_mutex_destroy(&_lock);
+}
+
+// ----------------------------------------------------------------
+// public member functions
+
+size_t ThreadPool::workers() const {
+    return _workers.size();
+}
+
+void ThreadPool::parallelFor(Task &task, size_t count, size_t grain) {
+    if (count == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+    size_t chunks = (count + grain - 1) / grain;
+    // Set before any chunk is visible: workers still leaving the previous
+    // loop may pick the new chunks up at once
+    pthread_mutex_lock(&_lock);
+    _remaining = chunks;
+    pthread_mutex_unlock(&_lock);
+
+    // Each worker gets a contiguous run of chunks
+    size_t workers = _queues.size();
+    for (size_t w = 0; w < workers; ++w) {
+        Queue &queue = *_queues[w];
+        pthread_mutex_lock(&queue.lock);
+        for (size_t c = w * chunks / workers; c < (w + 1) * chunks / workers;
+             ++c) {
+            Chunk chunk = {&task, c * grain, c * grain + grain};
+            if (chunk.end > count)
+                chunk.end = count;
+            queue.chunks.push_back(chunk);
+        }
+        pthread_mutex_unlock(&queue.lock);
+    }
+
+    pthread_mutex_lock(&_lock);
+    ++_generation;
+    pthread_cond_broadcast(&_wake);
+    pthread_mutex_unlock(&_lock);
+
+    _work(0);
+    pthread_mutex_lock(&_lock);
+    while (_remaining > 0)
+        pthread_cond_wait(&_done, &_lock);
+    pthread_mutex_unlock(&_lock);
+}
+
+// ----------------------------------------------------------------
+// private member functions
+
+void *ThreadPool::_main(void *arg) {
+    Worker *worker = static_cast<Worker *>(arg);
+    worker->pool->_loop(worker->index);
+    return NULL;
+}
+
+// Body of the worker threads: wait for a new loop, then help run it
+void ThreadPool::_loop(size_t worker) {
+    unsigned long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&_lock);
+        while (!_stopping && _generation == seen)
+            pthread_cond_wait(&_wake, &_lock);
+        if (_stopping) {
+            pthread_mutex_unlock(&_lock);
+            return;
+        }
+        seen = _generation;
+        pthread_mutex_unlock(&_lock);
+        _work(worker);
+    }
+}
+
+// Run chunks until no queue has any left
+void ThreadPool::_work(size_t worker) {
+    Chunk chunk;
+    while (_take(worker, chunk)) {
+        chunk.task->run(chunk.begin, chunk.end, worker);
+        pthread_mutex_lock(&_lock);
+        if (--_remaining == 0)
+            pthread_cond_broadcast(&_done);
+        pthread_mutex_unlock(&_lock);
+    }
+}
+
+// Next chunk for `worker`: the last of its own queue, or else the first one
+// of another queue, scanned from its neighbour on
+bool ThreadPool::_take(size_t worker, Chunk &chunk) {
+    size_t workers = _queues.size();
+    for (size_t k = 0; k < workers; ++k) {
+        Queue &queue = *_queues[(worker + k) % workers];
+        pthread_mutex_lock(&queue.lock);
+        bool found = !queue.chunks.empty();
+        if (found && k == 0) {
+            chunk = queue.chunks.back();
+            queue.chunks.pop_back();
+        } else if (found) {
+            chunk = queue.chunks.front();
+            queue.chunks.pop_front();
+        }
+        pthread_mutex_unlock(&queue.lock);
+        if (found)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,77 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+#include <pthread.h>
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Fixed set of worker threads running data-parallel loops. parallelFor()
+// splits the index range into chunks dealt to per-worker queues; a worker
+// takes chunks from the back of its own queue and, once it is empty, steals
+// from the front of the others, so uneven chunks still keep every thread
+// busy. The calling thread takes part as worker 0.
+class ThreadPool
+{
+public:
+    // Work over a range of indices; `worker` (below workers()) identifies
+    // the thread running it, for per-thread accumulators
+    class Task
+    {
+    public:
+        virtual ~Task();
+        virtual void run(size_t begin, size_t end, size_t worker) = 0;
+    };
+
+    // `threads` workers in total, the caller included. Fewer are used if
+    // the system refuses to create more threads.
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    size_t workers() const;
+
+    // Run task over [0, count) in chunks of `grain` indices and return once
+    // every chunk is done
+    void parallelFor(Task &task, size_t count, size_t grain);
+
+private:
+    struct Chunk
+    {
+        Task *task;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Queue
+    {
+        pthread_mutex_t lock;
+        std::deque<Chunk> chunks;
+    };
+
+    struct Worker
+    {
+        ThreadPool *pool;
+        size_t index;
+    };
+
+    std::vector<pthread_t> _threads;
+    std::vector<Worker> _workers;
+    std::vector<Queue *> _queues;
+    pthread_mutex_t _lock; // guards the fields below
+    pthread_cond_t _wake;
+    pthread_cond_t _done;
+    size_t _remaining;     // chunks of the running loop not finished
+    unsigned long _generation; // number of loops started
+    bool _stopping;
+
+    static void *_main(void *arg);
+    void _loop(size_t worker);
+    void _work(size_t worker);
+    bool _take(size_t worker, Chunk &chunk);
+
+    ThreadPool();                                   // = delete;
+    ThreadPool(ThreadPool const &other);            // = delete;
+    ThreadPool &operator=(ThreadPool const &other); // = delete;
+};
+
+#endif /* THREADPOOL_HPP */
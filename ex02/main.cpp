@@ -1,12 +1,22 @@
+#include <stdint.h>
+
 #include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cmath>
 #include <cstdlib>
 #include <ctime>
 #include <deque>
+#include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include "Arena.hpp"
+#include "ExternalSort.hpp"
 #include "PmergeMe.hpp"
 
 const std::clock_t CLOCKS_PER_MS = CLOCKS_PER_SEC / 1000;
@@ -25,6 +35,533 @@ void printTime(std::clock_t elapsed) {
     }
 }
 
+#ifdef DEBUG
+template <typename Container, typename Compare>
+void assertSorted(Container const &sorted, Container expected, Compare comp) {
+    std::sort(expected.begin(), expected.end(), comp);
+    assert(sorted.size() == expected.size());
+    assert(std::equal(sorted.begin(), sorted.end(), expected.begin()));
+}
+
+void testArena() {
+    Arena arena(1024);
+    void *first = arena.allocate(100);
+    void *second = arena.allocate(10);
+    assert(arena.used() == 128);
+    arena.deallocate(first, 100);  // not the last allocation: kept
+    assert(arena.used() == 128);
+    arena.deallocate(second, 10);
+    assert(arena.used() == 112 && arena.allocate(1) == second);
+    arena.allocate(4096);  // does not fit: new chunk
+    assert(arena.chunks() == 2 && arena.peak() == 112 + 16 + 4096);
+    arena.release();
+    assert(arena.used() == 0 && arena.chunks() == 0);
+
+    ArenaAllocator<int> allocator(&arena);
+    std::vector<int, ArenaAllocator<int> > numbers(allocator);
+    for (int i = 0; i < 1000; ++i)
+        numbers.push_back(i);
+    assert(numbers[999] == 999 && arena.used() >= 1000 * sizeof(int));
+}
+
+void testFordJohnson() {
+    std::vector<int64_t> wide;
+    for (int64_t i = 0; i < 100; ++i)
+        wide.push_back((i * 7919) % 101 * INT64_C(100000000000) - i);
+    FordJohnson<std::vector, int64_t, std::greater<int64_t> > descending(
+        "Test ");
+    assertSorted(descending.sort(wide), wide, std::greater<int64_t>());
+
+    std::deque<int> duplicates;
+    for (int i = 0; i < 33; ++i)
+        duplicates.push_back(i % 4);
+    FordJohnson<std::deque, int> ascending("Test ");
+    assertSorted(ascending.sort(duplicates), duplicates, std::less<int>());
+    assertSorted(ascending.sort(std::deque<int>()), std::deque<int>(),
+        std::less<int>());
+
+    const char *words[] = {"merge", "insertion", "ford", "johnson", "sort"};
+    std::vector<std::string> strings(words, words + 5);
+    FordJohnson<std::vector, std::string> collate("Test ");
+    assertSorted(collate.sort(strings), strings, std::less<std::string>());
+}
+
+void testComparisonCount() {
+    typedef FordJohnson<std::vector, int> Engine;
+    assert(Engine::worstCaseComparisons(0) == 0);
+    assert(Engine::worstCaseComparisons(5) == 7);
+    assert(Engine::worstCaseComparisons(21) == 66);
+
+    // Over every permutation, the worst case is exactly F(n)
+    Engine engine("Bound ");
+    for (size_t n = 1; n <= 6; ++n) {
+        std::vector<int> numbers;
+        for (size_t i = 0; i < n; ++i)
+            numbers.push_back(static_cast<int>(i));
+        size_t worst = 0;
+        do {
+            assertSorted(engine.sort(numbers), numbers, std::less<int>());
+            worst = std::max(worst, engine.comparisons());
+        } while (std::next_permutation(numbers.begin(), numbers.end()));
+        assert(worst == Engine::worstCaseComparisons(n));
+    }
+
+    std::vector<int> numbers;
+    for (unsigned i = 0; i < 1000; ++i)
+        numbers.push_back(static_cast<int>(i * 2654435761U % 1000003U));
+    std::vector<int> sorted = engine.sort(numbers);
+    size_t comparisons = engine.comparisons();
+    assert(comparisons <= Engine::worstCaseComparisons(numbers.size()));
+    engine.sort(numbers);  // counted per call
+    assert(engine.comparisons() == comparisons);
+    // The deque backend's chain probes the same positions
+    FordJohnson<std::deque, int> deque("Bound ");
+    deque.sort(std::deque<int>(numbers.begin(), numbers.end()));
+    assert(deque.comparisons() == comparisons);
+
+    FordJohnson<std::vector, int, std::less<int>, std::allocator<int>,
+        NoComparisonCounter>
+        uncounted("Uncounted ");
+    assert(uncounted.sort(numbers) == sorted && uncounted.comparisons() == 0);
+}
+
+// Orders strings by length, counting the batches it resolves
+struct ByLength : BatchComparator<std::string> {
+    size_t *batches;
+    size_t *batched;
+
+    ByLength(size_t *b, size_t *c) : batches(b), batched(c) {}
+
+    bool operator()(std::string const &a, std::string const &b) const {
+        return a.size() < b.size();
+    }
+
+    void operator()(Comparison *batch, size_t count) {
+        ++*batches;
+        *batched += count;
+        for (size_t i = 0; i < count; ++i)
+            batch[i].less = (*this)(*batch[i].left, *batch[i].right);
+    }
+};
+
+void testBatchComparator() {
+    std::vector<std::string> strings;
+    for (size_t i = 0; i < 50; ++i)
+        strings.push_back(std::string(i * 37 % 50 + 1, 'x'));
+    size_t batches = 0;
+    size_t batched = 0;
+    ByLength byLength(&batches, &batched);
+    assertSorted(PmergeMe().mergeInsertSort(strings, byLength), strings,
+        byLength);
+    // One batch per level of 50, 25, 12, 6 and 3 elements
+    assert(batches == 5 && batched == 25 + 12 + 6 + 3 + 1);
+
+    FordJohnson<std::vector, std::string, ByLength> batchedEngine(
+        "Batched ", byLength);
+    batchedEngine.sort(strings);
+    std::vector<size_t> lengths;
+    for (size_t i = 0; i < strings.size(); ++i)
+        lengths.push_back(strings[i].size());
+    FordJohnson<std::vector, size_t> plainEngine("Plain ");
+    plainEngine.sort(lengths);
+    assert(batchedEngine.comparisons() == plainEngine.comparisons());
+}
+
+void testHybridSort() {
+    HybridSort<std::vector, int> ints("Hybrid ");
+    assert(ints.choose(64) == SORTING_NETWORK);
+    assert(ints.choose(65) == RADIX_SORT);
+    ints.setComparisonCost(EXPENSIVE_COMPARISONS);
+    assert(ints.choose(3) == FORD_JOHNSON);
+    HybridSort<std::vector, std::string> strings("Hybrid ");
+    assert(strings.choose(3) == FORD_JOHNSON);
+    HybridSort<std::deque, double, std::greater<double> > doubles("Hybrid ");
+    assert(doubles.choose(3) == SORTING_NETWORK);
+    assert(doubles.choose(100) == FORD_JOHNSON);
+
+    HybridSort<std::deque, int, std::greater<int> > network("Hybrid ");
+    for (int n = 0; n <= 64; ++n) {
+        std::deque<int> numbers;
+        for (int i = 0; i < n; ++i)
+            numbers.push_back(i * 7 % 5 - i);
+        assertSorted(network.sort(numbers), numbers, std::greater<int>());
+        assert(network.lastAlgorithm() == SORTING_NETWORK);
+    }
+
+    std::vector<int> numbers;
+    for (int i = 0; i < 1000; ++i)
+        numbers.push_back(i * 1000003 ^ (i % 3 == 0 ? INT_MIN : 0));
+    numbers.push_back(INT_MAX);
+    HybridSort<std::vector, int> radix("Hybrid ");
+    assertSorted(radix.sort(numbers), numbers, std::less<int>());
+    assert(radix.lastAlgorithm() == RADIX_SORT && radix.comparisons() == 0);
+
+    std::vector<long> longs(numbers.begin(), numbers.end());
+    longs.push_back(LONG_MIN);
+    HybridSort<std::vector, long, std::greater<long> > descending("Hybrid ");
+    assertSorted(descending.sort(longs), longs, std::greater<long>());
+    assert(descending.lastAlgorithm() == RADIX_SORT);
+}
+
+void testParallelFordJohnson() {
+    std::vector<int> numbers;
+    for (unsigned i = 0; i < 5000; ++i)
+        numbers.push_back(static_cast<int>(i * 48271U % 65521U % 3000U));
+    FordJohnson<std::vector, int> sequential("Sequential ");
+    std::vector<int> expected = sequential.sort(numbers);
+    for (size_t threads = 2; threads <= 4; threads += 2) {
+        FordJohnson<std::vector, int> parallel("Parallel ");
+        parallel.setThreads(threads);
+        assert(parallel.sort(numbers) == expected);
+    }
+
+    std::deque<int> shuffled(numbers.rbegin(), numbers.rend());
+    FordJohnson<std::deque, int> deque("Parallel ");
+    deque.setThreads(3);
+    assertSorted(deque.sort(shuffled), shuffled, std::less<int>());
+
+    // Pairs (n/2 - i, n + i) put every pending element in the first gap:
+    // sorted in blocks and merged, so O(n log n) comparisons where inserting
+    // the gap one element at a time would take O(n^2)
+    typedef FordJohnson<std::vector, int> Engine;
+    size_t n = 40000;
+    std::vector<int> oneGap;
+    for (size_t i = 0; i < n / 2; ++i) {
+        oneGap.push_back(static_cast<int>(n / 2 - i));
+        oneGap.push_back(static_cast<int>(n + i));
+    }
+    Engine parallel("Parallel ");
+    parallel.setThreads(4);
+    assertSorted(parallel.sort(oneGap), oneGap, std::less<int>());
+    size_t bound = Engine::worstCaseComparisons(n);
+    assert(parallel.comparisons() <= bound + bound / 3);
+}
+
+void testRunDetection() {
+    FordJohnson<std::vector, int> engine("Runs ");
+    engine.setRunDetection(true);
+    std::vector<int> numbers;
+    for (int i = 0; i < 1000; ++i)
+        numbers.push_back(i / 3);
+    assertSorted(engine.sort(numbers), numbers, std::less<int>());
+    assert(engine.comparisons() == 999);
+    std::vector<int> reversed(numbers.rbegin(), numbers.rend());
+    assertSorted(engine.sort(reversed), reversed, std::less<int>());
+    assert(engine.comparisons() > 999);  // not strictly descending
+
+    // Strictly descending, then four interleaved runs: merged, far below F(n)
+    for (int i = 0; i < 1000; ++i)
+        numbers[i] = 1000 - i;
+    assertSorted(engine.sort(numbers), numbers, std::less<int>());
+    assert(engine.comparisons() == 999);
+    for (int i = 0; i < 1000; ++i)
+        numbers[i] = i % 250 * 4 + i / 250;
+    assertSorted(engine.sort(numbers), numbers, std::less<int>());
+    assert(engine.comparisons() <= 999 + 2 * 999);
+    numbers.insert(numbers.begin() + 500, 7);  // a short run in the middle
+    assertSorted(engine.sort(numbers), numbers, std::less<int>());
+
+    // Every permutation, runs or not
+    FordJohnson<std::deque, int> deque("Runs ");
+    deque.setRunDetection(true);
+    for (int n = 1; n <= 7; ++n) {
+        std::deque<int> permutation;
+        for (int i = 0; i < n; ++i)
+            permutation.push_back(i / 2);
+        do {
+            assertSorted(deque.sort(permutation), permutation,
+                std::less<int>());
+        } while (std::next_permutation(permutation.begin(), permutation.end()));
+    }
+
+    // Opt-in for PmergeMe, which otherwise keeps to F(n)
+    std::vector<int> ascending;
+    for (int i = 0; i < 100; ++i)
+        ascending.push_back(i);
+    PmergeMe pmergeMe(ascending);
+    pmergeMe.mergeInsertSortByVector();
+    assert(pmergeMe.vectorComparisons() > 99);
+    pmergeMe.setRunDetection(true);
+    assert(pmergeMe.mergeInsertSortByVector() == ascending);
+    assert(pmergeMe.vectorComparisons() == 99);
+}
+
+void testDuplicateCollapsing() {
+    std::vector<int> numbers;
+    for (unsigned i = 0; i < 1000; ++i)
+        numbers.push_back(static_cast<int>(i * 2654435761U % 1000003U % 10));
+    FordJohnson<std::vector, int> plain("Plain ");
+    std::vector<int> expected = plain.sort(numbers);
+    FordJohnson<std::vector, int> grouped("Grouped ");
+    grouped.setDuplicateCollapsing(true);
+    assert(grouped.sort(numbers) == expected);
+    // At most log2(10 + 1) + 1 per element
+    assert(grouped.comparisons() <= 5 * 1000);
+    assert(3 * grouped.comparisons() < 2 * plain.comparisons());
+
+    // Distinct keys: Ford-Johnson takes over
+    for (int i = 0; i < 1000; ++i)
+        numbers[i] = i * 7 % 1000;
+    assertSorted(grouped.sort(numbers), numbers, std::less<int>());
+
+    // Equal elements keep their input order
+    std::vector<std::string> words;
+    for (size_t i = 0; i < 300; ++i) {
+        char letter = static_cast<char>('a' + i % 26);
+        words.push_back(std::string(i * 7 % 5 + 1, letter));
+    }
+    size_t batches = 0;
+    size_t batched = 0;
+    ByLength byLength(&batches, &batched);
+    PmergeMe pmergeMe;
+    pmergeMe.setDuplicateCollapsing(true);
+    std::vector<std::string> expectedWords = words;
+    std::stable_sort(expectedWords.begin(), expectedWords.end(), byLength);
+    assert(pmergeMe.mergeInsertSort(words, byLength) == expectedWords);
+}
+
+// Orders indices by the keys they refer to, the first index on ties
+struct ByKey {
+    std::vector<int> const *keys;
+
+    explicit ByKey(std::vector<int> const *k) : keys(k) {}
+
+    bool operator()(size_t a, size_t b) const {
+        return (*keys)[a] < (*keys)[b] || ((*keys)[a] == (*keys)[b] && a < b);
+    }
+};
+
+void testArgsort() {
+    std::vector<int> keys;
+    std::vector<std::string> records;
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < 500; ++i) {
+        keys.push_back(static_cast<int>(i * 7 % 13));
+        records.push_back(std::string(1, static_cast<char>('a' + i % 26)));
+        expected.push_back(i);
+    }
+    std::sort(expected.begin(), expected.end(), ByKey(&keys));
+
+    FordJohnson<std::vector, int> engine("Argsort ");
+    std::vector<size_t> permutation = engine.argsort(keys);
+    std::vector<int> sortedKeys = keys;
+    applyPermutation(sortedKeys, permutation);
+    assert(sortedKeys == engine.sort(keys));
+    assert(engine.argsort(keys, true) == expected);
+    assert(PmergeMe().mergeInsertArgsort(keys, std::less<int>(), true) ==
+           expected);
+
+    // Records follow their keys
+    std::vector<std::string> sortedRecords = records;
+    applyPermutation(sortedRecords, expected);
+    for (size_t i = 0; i < records.size(); ++i)
+        assert(sortedRecords[i] == records[expected[i]]);
+    std::deque<std::string> deque(records.begin(), records.end());
+    applyPermutation(deque, expected);
+    assert(std::equal(deque.begin(), deque.end(), sortedRecords.begin()));
+
+    assert(engine.argsort(std::vector<int>()).empty());
+    std::vector<size_t> invalid(keys.size(), 0);
+    try {
+        applyPermutation(sortedKeys, invalid);
+        assert(false);
+    } catch (std::invalid_argument const &) {
+        assert(sortedKeys == engine.sort(keys));  // left untouched
+    }
+}
+
+void testRangeSort() {
+    int raw[] = {42, 7, 19, 7, 3, 88, 0, 56, 23, 11, 64};
+    std::vector<int> expected(raw, raw + 11);
+    std::sort(expected.begin(), expected.end());
+    PmergeMe pmergeMe;
+    pmergeMe.mergeInsertSortByVector(raw, raw + 11);
+    assert(std::equal(raw, raw + 11, expected.begin()));
+
+    std::vector<int> numbers;
+    for (unsigned i = 0; i < 3000; ++i)
+        numbers.push_back(static_cast<int>(i * 2654435761U % 1000003U));
+    std::vector<int> out(numbers.size());
+    assert(pmergeMe.mergeInsertSortByDeque(numbers.begin(), numbers.end(),
+               out.begin()) == out.end());
+    assertSorted(out, numbers, std::less<int>());
+
+    // Same comparisons as sorting a copy, then in place in the caller's array
+    FordJohnson<std::deque, int> engine("Range ");
+    std::deque<int> copy(numbers.begin(), numbers.end());
+    engine.sort(copy);
+    size_t comparisons = engine.comparisons();
+    engine.sort(numbers.begin(), numbers.end());
+    assert(numbers == out && engine.comparisons() == comparisons);
+}
+
+void testPartialSort() {
+    std::vector<int> numbers;
+    for (unsigned i = 0; i < 1000; ++i)
+        numbers.push_back(static_cast<int>(i * 2654435761U % 1000003U % 500));
+    std::vector<int> sorted = numbers;
+    std::sort(sorted.begin(), sorted.end());
+    PmergeMe pmergeMe(numbers);
+    pmergeMe.mergeInsertSortByVector();
+    size_t fullComparisons = pmergeMe.vectorComparisons();
+
+    assert(pmergeMe.partialSortByVector(1) == std::vector<int>(1, sorted[0]));
+    assert(pmergeMe.vectorComparisons() == 999);  // a plain tournament
+    std::vector<int> smallest = pmergeMe.partialSortByVector(10);
+    assert(std::equal(smallest.begin(), smallest.end(), sorted.begin()));
+    assert(smallest.size() == 10);
+    assert(3 * pmergeMe.vectorComparisons() < fullComparisons);
+    assert(pmergeMe.partialSortByVector(5000) == sorted);
+    assert(pmergeMe.partialSortByVector(0).empty());
+    assert(pmergeMe.vectorComparisons() == 0);
+
+    FordJohnson<std::deque, int> engine("Partial ");
+    for (size_t n = 0; n <= 40; ++n) {
+        std::deque<int> prefix(numbers.begin(), numbers.begin() + n);
+        std::deque<int> expected = prefix;
+        std::sort(expected.begin(), expected.end());
+        for (size_t k = 0; k <= n + 1; ++k) {
+            std::deque<int> top = engine.partialSort(prefix, k);
+            assert(top.size() == std::min(k, n));
+            assert(std::equal(top.begin(), top.end(), expected.begin()));
+        }
+    }
+
+    std::vector<std::string> words;
+    for (size_t i = 0; i < 100; ++i)
+        words.push_back(std::string(i * 37 % 100 + 1, 'x'));
+    size_t batches = 0;
+    size_t batched = 0;
+    ByLength byLength(&batches, &batched);
+    std::vector<std::string> shortest =
+        PmergeMe().mergeInsertPartialSort(words, 3, byLength);
+    assert(shortest.size() == 3 && shortest[2] == std::string(3, 'x'));
+}
+
+void testExternalSort() {
+    std::vector<int> numbers;
+    std::stringstream input;
+    for (unsigned i = 0; i < 3000; ++i) {
+        numbers.push_back(static_cast<int>(i * 2654435761U % 1000003U) - 500);
+        input << numbers.back() << (i % 10 == 9 ? "\n" : "  ");
+    }
+    std::sort(numbers.begin(), numbers.end());
+
+    // In memory, one level of merge, then two (more than 256 runs)
+    size_t chunks[] = {5000, 100, 10};
+    size_t runs[] = {1, 30, 300};
+    for (size_t c = 0; c < 3; ++c) {
+        std::stringstream in(input.str());
+        std::stringstream out;
+        ExternalSort sorter(chunks[c]);
+        assert(sorter.sort(in, out) == numbers.size());
+        assert(sorter.runs() == runs[c]);
+        std::vector<int> sorted;
+        int value;
+        while (out >> value)
+            sorted.push_back(value);
+        assert(sorted == numbers);
+    }
+
+    // Chunk and scratch together within the budget
+    size_t perElement =
+        sizeof(int) + FordJohnson<std::vector, int>::scratchBytes(1);
+    assert(ExternalSort::chunkElementsFor(1000 * perElement) == 1000);
+    assert(ExternalSort::chunkElementsFor(perElement - 1) == 1);
+
+    ExternalSort sorter(10);
+    std::stringstream empty;
+    std::stringstream out;
+    assert(sorter.sort(empty, out) == 0 && out.str().empty());
+    std::stringstream trailing("1 2 3\n \n");
+    assert(sorter.sort(trailing, out) == 3);
+    char const *invalid[] = {"1 2 3 x 4", "5 -", "5 99999999999", "7 8x"};
+    for (size_t i = 0; i < 4; ++i) {
+        std::stringstream in(invalid[i]);
+        try {
+            sorter.sort(in, out);
+            assert(false);
+        } catch (std::invalid_argument const &) {
+        }
+    }
+}
+
+void testIncrementalInsert() {
+    std::vector<int> numbers;
+    for (unsigned i = 0; i < 2000; ++i)
+        numbers.push_back(static_cast<int>(i * 2654435761U % 1000003U % 5000));
+    std::vector<int> initial(numbers.begin(), numbers.begin() + 1000);
+    PmergeMe pmergeMe(initial);
+    std::vector<int> expected = initial;
+    std::sort(expected.begin(), expected.end());
+    assert(pmergeMe.sorted() == expected);
+
+    // Batches of m elements merged into n: sorting the batch, then about
+    // m * (log2(n / m) + 2) comparisons, far below resorting everything
+    typedef FordJohnson<std::vector, int> Engine;
+    size_t sizes[] = {1, 10, 100, 889};
+    size_t first = 1000;
+    for (size_t i = 0; i < 4; ++i) {
+        size_t m = sizes[i];
+        std::vector<int> batch(
+            numbers.begin() + first, numbers.begin() + first + m);
+        first += m;
+        size_t n = expected.size();
+        pmergeMe.insert(batch);
+        expected.insert(expected.end(), batch.begin(), batch.end());
+        std::sort(expected.begin(), expected.end());
+        assert(pmergeMe.sorted() == expected);
+        double merge = m * (std::log(n / m + 1.0) / std::log(2.0) + 2);
+        assert(pmergeMe.vectorComparisons() <=
+               Engine::worstCaseComparisons(m) + merge);
+        assert(pmergeMe.vectorComparisons() <
+               Engine::worstCaseComparisons(n + m));
+    }
+    assert(pmergeMe.mergeInsertSortByVector() == expected);
+
+    // Into a deque, equal elements after those already there
+    FordJohnson<std::deque, int> engine("Insert ");
+    std::deque<int> sorted(3, 5);
+    engine.insert(sorted, std::deque<int>(2, 5));
+    engine.insert(sorted, std::deque<int>());
+    int values[] = {9, 0, 5, 7};
+    engine.insert(sorted, std::deque<int>(values, values + 4));
+    int all[] = {0, 5, 5, 5, 5, 5, 5, 7, 9};
+    assert(std::equal(sorted.begin(), sorted.end(), all) && sorted.size() == 9);
+}
+
+void testPairKernel() {
+    // Ties, extremes and a tail that does not fill a vector
+    std::vector<int> keys;
+    for (unsigned i = 0; i < 46; ++i)
+        keys.push_back(static_cast<int>(i * 2654435761U % 7U) - 3);
+    keys[4] = INT_MIN;
+    keys[9] = INT_MAX;
+    size_t count = keys.size() / 2;
+    std::vector<int> largerKeys(count);
+    std::vector<uint32_t> largerIds(count);
+    PairKernel<int, std::less<int> >::run(
+        &keys[0], count, 10, &largerKeys[0], &largerIds[0]);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t larger = keys[2 * i + 1] < keys[2 * i] ? 0 : 1;
+        assert(largerIds[i] == 10 + 2 * i + larger);
+        assert(largerKeys[i] == keys[2 * i + larger]);
+    }
+
+    // Through the kernel or the comparator, equal keys pair alike
+    FordJohnson<std::vector, int> vector("Pairs ");
+    FordJohnson<std::deque, int> deque("Pairs ");
+    std::deque<int> copy(keys.begin(), keys.end());
+    std::vector<int> sorted(keys.size());
+    vector.sort(keys.begin(), keys.end(), sorted.begin());
+    std::deque<int> expected = deque.sort(copy);
+    assert(std::equal(sorted.begin(), sorted.end(), expected.begin()));
+    assert(vector.comparisons() == deque.comparisons());
+    assert(vector.argsort(keys) == deque.argsort(copy));
+    assert(vector.comparisons() == deque.comparisons());
+}
+#endif
+
 bool invalidArgument(const std::string &str) {
     for (size_t i = 0; i < str.length(); ++i) {
         if (!isdigit(str[i]) && !(i == 0 && str[i] == '-')) {
@@ -34,7 +571,32 @@ bool invalidArgument(const std::string &str) {
     return false;
 }
 
+// --file mode: sort the integers of a file that may not fit in memory
+int sortFile(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Error: Usage: " << argv[0] << " --file <path>"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::ifstream input(argv[2]);
+    if (!input) {
+        std::cerr << "Error: Could not open '" << argv[2] << "'." << std::endl;
+        return EXIT_FAILURE;
+    }
+    try {
+        ExternalSort sorter(ExternalSort::chunkElementsFor(
+            ExternalSort::DEFAULT_MEMORY_BYTES));
+        sorter.sort(input, std::cout);
+    } catch (std::exception const &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[]) {
+    if (argc >= 2 && std::string(argv[1]) == "--file")
+        return sortFile(argc, argv);
     if (argc < 2) {
         std::cerr << "Error: At least one integer argument is required."
                   << std::endl;
@@ -82,6 +644,13 @@ int main(int argc, char *argv[]) {
     end = std::clock();
     elapsedDeq = end - start;
 
+    // Sort with the algorithm picked for the input
+    std::clock_t elapsedAuto;
+    start = std::clock();
+    std::vector<int> sortedByAuto = pmergeMe.autoSort();
+    end = std::clock();
+    elapsedAuto = end - start;
+
     // Print original sequence
     std::cout << "Before: ";
     for (size_t i = 0; i < numbers.size(); ++i) {
@@ -107,6 +676,10 @@ int main(int argc, char *argv[]) {
     std::cout << "Time to process a range of " << std::setw(3) << numbers.size()
               << " elements with std::deque  :";
     printTime(elapsedDeq);
+    std::cout << "Time to process a range of " << std::setw(3) << numbers.size()
+              << " elements with auto ("
+              << sortAlgorithmName(pmergeMe.autoAlgorithm()) << "):";
+    printTime(elapsedAuto);
 
 #ifdef DEBUG
     // Verify both sorted results are the same
@@ -123,6 +696,25 @@ int main(int argc, char *argv[]) {
         assert(sortedByArgorithm[i] == sortedByVec[i]);
         assert(sortedByArgorithm[i] == sortedByDeq[i]);
     }
+    assert(sortedByAuto == sortedByArgorithm);
+    typedef FordJohnson<std::vector, int> Engine;
+    assert(pmergeMe.vectorComparisons() == pmergeMe.dequeComparisons());
+    assert(pmergeMe.vectorComparisons() <=
+           Engine::worstCaseComparisons(numbers.size()));
+    testArena();
+    testFordJohnson();
+    testComparisonCount();
+    testBatchComparator();
+    testHybridSort();
+    testParallelFordJohnson();
+    testRunDetection();
+    testDuplicateCollapsing();
+    testArgsort();
+    testRangeSort();
+    testPartialSort();
+    testExternalSort();
+    testIncrementalInsert();
+    testPairKernel();
     std::cout << "------------------------------------------------"
               << std::endl;
     std::cout << "Debug test passed." << std::endl;